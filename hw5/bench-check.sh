@@ -0,0 +1,46 @@
+#!/bin/bash
+# Scaling benchmark of the parallel semantic analysis (hw5 --check-threads).
+# Build with "make" first.
+# Usage:
+#   ./bench-check.sh file.in [max threads] [runs]   times --check-only on 1, 2, 4, ... threads, up to 32 by default
+
+binary="./hw5"
+
+if [ ! -x "$binary" ]
+	then
+	echo "$binary not found, run make first"
+	exit 1
+fi
+
+input="$1"
+max="${2:-32}"
+runs="${3:-5}"
+
+if [ ! -f "$input" ]
+	then
+	echo "usage: $0 file.in [max threads] [runs]"
+	exit 1
+fi
+
+reference=$( $binary --check-only --check-threads 1 < "$input" )
+base=0
+for (( threads = 1; threads <= max; threads *= 2 ))
+	do
+	if [ "$( $binary --check-only --check-threads $threads < "$input" )" != "$reference" ]
+		then
+		echo "$threads threads: output differs from 1 thread"
+		exit 1
+	fi
+	start=$( date +%s%N )
+	for (( i = 0; i < runs; i++ ))
+		do
+		$binary --check-only --check-threads $threads < "$input" > /dev/null
+	done
+	end=$( date +%s%N )
+	ms=$(( (end - start) / 1000000 / runs ))
+	if [ $base -eq 0 ]
+		then
+		base=$(( ms > 0 ? ms : 1 ))
+	fi
+	echo "$threads threads: $ms ms, speedup $(( base * 100 / (ms > 0 ? ms : 1) ))%"
+done
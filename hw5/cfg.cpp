@@ -0,0 +1,140 @@
+#include "cfg.hpp"
+#include <algorithm>
+
+namespace ir {
+
+    std::vector<Block *> successors(const Block *block) {
+        const Instruction *terminator = block->last;
+        if (!terminator || terminator->op == Opcode::RET) {
+            return {};
+        }
+        return std::vector<Block *>(terminator->targets, terminator->targets + terminator->numTargets);
+    }
+
+    Cfg::Cfg(const Function &function)
+            : preds(function.numBlocks), rpoIndex(function.numBlocks, -1), idom(function.numBlocks, nullptr) {
+        for (Block *block = function.first; block; block = block->next) {
+            for (Block *succ: successors(block)) {
+                preds[succ->id].push_back(block);
+            }
+        }
+
+        // Depth-first search without recursion, a block is finished once all its successors are
+        std::vector<bool> seen(function.numBlocks, false);
+        std::vector<std::pair<Block *, size_t>> stack;
+        std::vector<Block *> postorder;
+        seen[function.first->id] = true;
+        stack.emplace_back(function.first, 0);
+        while (!stack.empty()) {
+            Block *block = stack.back().first;
+            std::vector<Block *> succs = successors(block);
+            if (stack.back().second < succs.size()) {
+                Block *succ = succs[stack.back().second++];
+                if (!seen[succ->id]) {
+                    seen[succ->id] = true;
+                    stack.emplace_back(succ, 0);
+                }
+            } else {
+                postorder.push_back(block);
+                stack.pop_back();
+            }
+        }
+        order.assign(postorder.rbegin(), postorder.rend());
+        for (size_t i = 0; i < order.size(); i++) {
+            rpoIndex[order[i]->id] = i;
+        }
+
+        // The entry is its own dominator while iterating, and loses it at the end
+        Block *entry = function.first;
+        idom[entry->id] = entry;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = 1; i < order.size(); i++) {
+                Block *block = order[i];
+                Block *dominator = nullptr;
+                for (Block *pred: preds[block->id]) {
+                    if (!idom[pred->id]) {
+                        continue;
+                    }
+                    if (!dominator) {
+                        dominator = pred;
+                        continue;
+                    }
+                    // Intersect: walk both up the tree until they meet
+                    Block *a = pred;
+                    while (a != dominator) {
+                        while (rpoIndex[a->id] > rpoIndex[dominator->id]) {
+                            a = idom[a->id];
+                        }
+                        while (rpoIndex[dominator->id] > rpoIndex[a->id]) {
+                            dominator = idom[dominator->id];
+                        }
+                    }
+                }
+                if (idom[block->id] != dominator) {
+                    idom[block->id] = dominator;
+                    changed = true;
+                }
+            }
+        }
+        idom[entry->id] = nullptr;
+    }
+
+    bool Cfg::dominates(const Block *a, const Block *b) const {
+        if (!reachable(a) || !reachable(b)) {
+            return false;
+        }
+        // Dominators come first in reverse postorder, so the walk can stop once it passes a
+        while (b && rpoIndex[b->id] > rpoIndex[a->id]) {
+            b = idom[b->id];
+        }
+        return b == a;
+    }
+
+    std::vector<Loop> findLoops(const Function &function, const Cfg &cfg) {
+        std::vector<Loop> loops;
+        std::vector<int> loopOf(function.numBlocks, -1);
+        for (Block *block: cfg.order) {
+            for (Block *header: successors(block)) {
+                if (!cfg.dominates(header, block)) {
+                    continue;
+                }
+                if (loopOf[header->id] < 0) {
+                    loopOf[header->id] = loops.size();
+                    loops.push_back({header, {}, std::vector<bool>(function.numBlocks, false)});
+                    loops.back().contains[header->id] = true;
+                }
+                // The loop is everything that reaches the back edge without passing through the header
+                Loop &loop = loops[loopOf[header->id]];
+                std::vector<Block *> work;
+                if (!loop.contains[block->id]) {
+                    loop.contains[block->id] = true;
+                    work.push_back(block);
+                }
+                while (!work.empty()) {
+                    Block *inside = work.back();
+                    work.pop_back();
+                    for (Block *pred: cfg.preds[inside->id]) {
+                        if (cfg.reachable(pred) && !loop.contains[pred->id]) {
+                            loop.contains[pred->id] = true;
+                            work.push_back(pred);
+                        }
+                    }
+                }
+            }
+        }
+        for (Loop &loop: loops) {
+            for (Block *block: cfg.order) {
+                if (loop.contains[block->id]) {
+                    loop.blocks.push_back(block);
+                }
+            }
+        }
+        // A loop inside another has fewer blocks
+        std::stable_sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {
+            return a.blocks.size() < b.blocks.size();
+        });
+        return loops;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef CFG_HPP
+#define CFG_HPP
+
+#include "ir.hpp"
+
+/* Control flow graph of a function, computed from the terminators of its blocks. Everything is indexed by block id.
+ * The dominator tree is computed with the iterative algorithm of Cooper, Harvey and Kennedy, "A Simple, Fast
+ * Dominance Algorithm". Unreachable blocks are left out of the order and have no immediate dominator.
+ */
+namespace ir {
+
+    // The targets of the block's terminator, none for a return
+    std::vector<Block *> successors(const Block *block);
+
+    class Cfg {
+    public:
+        std::vector<std::vector<Block *>> preds;
+        // The reachable blocks in reverse postorder, the entry first
+        std::vector<Block *> order;
+        // Position of every block in order, -1 for unreachable blocks
+        std::vector<int> rpoIndex;
+        // Immediate dominator of every block, nullptr for the entry and for unreachable blocks
+        std::vector<Block *> idom;
+
+        explicit Cfg(const Function &function);
+
+        bool reachable(const Block *block) const {
+            return rpoIndex[block->id] >= 0;
+        }
+
+        // Whether a dominates b; every block dominates itself
+        bool dominates(const Block *a, const Block *b) const;
+    };
+
+    /* Natural loop: the header dominates the blocks of the loop, and every back edge (an edge into the header from a
+     * block it dominates) comes from inside. The back edges of a header share one loop.
+     */
+    struct Loop {
+        Block *header;
+        // The blocks of the loop in reverse postorder, the header first
+        std::vector<Block *> blocks;
+        // Whether every block, indexed by id, is in the loop
+        std::vector<bool> contains;
+    };
+
+    // The natural loops of the function, inner loops before the loops around them
+    std::vector<Loop> findLoops(const Function &function, const Cfg &cfg);
+}
+
+#endif //CFG_HPP
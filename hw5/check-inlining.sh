@@ -0,0 +1,55 @@
+#!/bin/bash
+# Checks that small functions are really inlined: the caller's IR calls the callee with --no-inline and no longer
+# does without it, whichever of the two comes first in the program, and the program still prints the expected output.
+# Build with "make" first.
+# Usage:
+#   ./check-inlining.sh                         checks the cases listed below
+#   ./check-inlining.sh file.in caller callee   checks that callee is inlined into caller
+
+binary="./hw5"
+
+if [ ! -x "$binary" ]
+	then
+	echo "$binary not found, run make first"
+	exit 1
+fi
+
+# The test, the caller and the callee inlined into it
+cases=(
+	"hw5-tests/t1.in main printByValue"
+)
+if [ $# == 3 ]
+	then
+	cases=( "$1 $2 $3" )
+fi
+
+# Prints the IR of one function of a module
+body() {
+	awk -v header="@$2(" 'index($0, "define ") == 1 && index($0, header) { inside = 1 } inside { print } $0 == "}" { inside = 0 }' <<< "$1"
+}
+
+passed=0
+failed=0
+for case in "${cases[@]}"
+	do
+	read -r test caller callee <<< "$case"
+	inlined=$( $binary < "$test" )
+	called=$( $binary --no-inline < "$test" )
+	if ! body "$called" "$caller" | grep -q "call .*@$callee("
+		then
+		failed=$(( failed + 1 ))
+		echo "$caller does not call $callee in $test"
+	elif body "$inlined" "$caller" | grep -q "call .*@$callee("
+		then
+		failed=$(( failed + 1 ))
+		echo "$callee is not inlined into $caller in $test"
+	elif [ -f "${test%.in}.out" ] && ! diff <( lli <<< "$inlined" 2>&1 ) "${test%.in}.out" > /dev/null
+		then
+		failed=$(( failed + 1 ))
+		echo "Wrong output after inlining $test"
+	else
+		passed=$(( passed + 1 ))
+	fi
+done
+echo "$passed inlined, $failed not"
+[ $failed == 0 ]
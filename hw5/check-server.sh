@@ -0,0 +1,51 @@
+#!/bin/bash
+# Regression test of the compile server (hw5 --serve): a request that fails inside the compiler gets the diagnostic
+# and a non-zero status, and the same worker then still answers a good request like the command line compiler.
+# Build with "make" first.
+# Usage:
+#   ./check-server.sh [good.in]   hw5-tests/t1.in by default
+
+binary="./hw5"
+
+if [ ! -x "$binary" ]
+	then
+	echo "$binary not found, run make first"
+	exit 1
+fi
+
+good="${1:-hw5-tests/t1.in}"
+socket="$( mktemp -u /tmp/hw5-server.XXXXXX )"
+
+# One worker, so both requests go to the same session
+$binary --serve "$socket" --workers 1 &
+server=$!
+trap 'kill $server 2> /dev/null; rm -f "$socket"' EXIT
+for (( i = 0; i < 50; i++ ))
+	do
+	[ -S "$socket" ] && break
+	sleep 0.1
+done
+
+failed=0
+# The constant does not fit in an int, converting it throws out of the parser
+if answer=$( echo 'void main() { printi(99999999999); }' | $binary --connect "$socket" 2>&1 )
+	then
+	failed=$(( failed + 1 ))
+	echo "The bad request succeeded: $answer"
+elif [[ "$answer" != Error:* ]]
+	then
+	failed=$(( failed + 1 ))
+	echo "The bad request got no diagnostic: $answer"
+fi
+if ! diff <( $binary --connect "$socket" < "$good" ) <( $binary < "$good" ) > /dev/null
+	then
+	failed=$(( failed + 1 ))
+	echo "The server answers $good differently after the bad request"
+fi
+if ! kill -0 $server 2> /dev/null
+	then
+	failed=$(( failed + 1 ))
+	echo "The server is gone"
+fi
+echo "$failed failed"
+[ $failed == 0 ]
@@ -0,0 +1,52 @@
+#!/bin/bash
+# Differential test and parse-throughput benchmark of the bison parser against the hand-written one (hw5 --rd).
+# Build with "make" first.
+# Usage:
+#   ./compare-parsers.sh [test dirs...]           runs both parsers on every .in file and compares the outputs
+#   ./compare-parsers.sh --bench file.in [runs]   times parsing only (--parse-only) with each parser
+
+binary="./hw5"
+
+if [ ! -x "$binary" ]
+	then
+	echo "$binary not found, run make first"
+	exit 1
+fi
+
+if [ "$1" == "--bench" ]
+	then
+	input="$2"
+	runs="${3:-10}"
+	bytes=$( wc -c < "$input" )
+	for parser in "" "--rd"
+		do
+		start=$( date +%s%N )
+		for (( i = 0; i < runs; i++ ))
+			do
+			$binary $parser --parse-only < "$input" > /dev/null
+		done
+		end=$( date +%s%N )
+		ms=$(( (end - start) / 1000000 / runs ))
+		echo "${parser:-bison}: $ms ms per parse, $(( bytes / 1024 * 1000 / (ms > 0 ? ms : 1) )) KB/s"
+	done
+	exit 0
+fi
+
+dirs="${@:-hw5-tests ../hw3/hw3-tests}"
+passed=0
+failed=0
+for dir in $dirs
+	do
+	for test in "$dir"/*.in
+		do
+		if diff <( $binary < "$test" 2>&1 ) <( $binary --rd < "$test" 2>&1 ) > /dev/null
+			then
+			passed=$(( passed + 1 ))
+		else
+			failed=$(( failed + 1 ))
+			echo "Parsers differ on $test"
+		fi
+	done
+done
+echo "$passed identical, $failed different"
+[ $failed == 0 ]
@@ -1,132 +1,718 @@
-#include "generator.hpp"
-
-extern output::CodeBuffer buffer;
-extern std::vector<std::shared_ptr<ast::Node>> tables = outputAndSymbolTable::mishtaneMisgeret;
-
-void LLVM_code_generator::globalFunctions() {
-    buffer.emit("@.DIV_BY_ZERO_ERROR = internal constant [23 x i8] c\"Error division by zero\\00\"");
-    buffer.emit("define void @check_division(i32) {");
-    buffer.emit("%valid = icmp eq i32 %0, 0");
-    buffer.emit("br i1 %valid, label %ILLEGAL, label %LEGAL");
-    buffer.emit("ILLEGAL:");
-    buffer.emit("call void @print(i8* getelementptr([23 x i8], [23 x i8]* @.DIV_BY_ZERO_ERROR, i32 0, i32 0))");
-    buffer.emit("call void @exit(i32 0)");
-    buffer.emit("ret void");
-    buffer.emit("LEGAL:");
-    buffer.emit("ret void");
-    buffer.emit("}");
-}
-
-string LLVM_code_generator::generate_load_var(string rbp, int offset) {
-    string reg = buffer.freshVar();
-    string var_ptr = buffer.freshVar();
-    buffer.emit(var_ptr + " = getelementptr i32, i32* " + rbp + ", i32 " + std::to_string(offset));
-    buffer.emit(reg + " = load i32, i32* " + var_ptr);
-    return reg;
-}
-
-void LLVM_code_generator::generate_store_var(string rbp, int offset, string reg) {
-    string var_ptr = buffer.freshVar();
-    buffer.emit(var_ptr + " = getelementptr i32, i32* " + rbp + ", i32 " + std::to_string(offset));
-    buffer.emit("store i32 " + reg + ", i32* " + var_ptr);
-}
-
-void LLVM_code_generator::binop_code(Exp *res, const Exp &operand1, const Exp &operand2, const string &op) {
-    res->erekhBituy = buffer.freshVar();
-    string op_text;
-    if (op == "+") {
-        op_text = "add";
-    } else if (op == "-") {
-        op_text = "sub";
-    } else if (op == "*") {
-        op_text = "mul";
-    } else {
-        if (res->type == ast::BuiltInType::INT) {
-            op_text = "sdiv";
-        } else {
-            op_text = "udiv";
-        }
-    }
-    if (op == "/") {
-        buffer.emit("call void @check_division(i32 " + operand2.erekhBituy + ")");
-        buffer.emit(res->erekhBituy + " = " + op_text + " i32 " + operand1.erekhBituy + ", " + operand2.erekhBituy);
-    } else {
-        buffer.emit(res->erekhBituy + " = " + op_text + " i32 " + operand1.erekhBituy + ", " + operand2.erekhBituy);
-        if (res->type == BYTE) {
-            string old_reg = res->erekhBituy;
-            res->erekhBituy = buffer.freshVar();
-            buffer.emit(res->erekhBituy + " = and i32 255, " + old_reg);
-        }
-    }
-}
-
-void LLVM_code_generator::relop_code(Exp *res, const Exp *operand1, const Exp *operand2, const string &op) {
-    res->erekhBituy = buffer.freshVar();
-    string op_text;
-    if (op == "==") {
-        op_text = "eq";
-    } else if (op == "!=") {
-        op_text = "ne";
-    } else if (op == ">") {
-        op_text = "sgt";
-    } else if (op == ">=") {
-        op_text = "sge";
-    } else if (op == "<") {
-        op_text = "slt";
-    } else {
-        op_text = "sle";
-    }
-
-    buffer.emit(res->erekhBituy + " = icmp " + op_text + " i32 " + operand1->erekhBituy + ", " + operand2->erekhBituy);
-    buffer.emit("br i1 " + res->erekhBituy + ", label @, label @");
-}
-
-void LLVM_code_generator::assign_code(Exp *exp, int offset, bool is_bool) {
-    if (is_bool) {
-        Exp *new_exp = bool_exp(exp);
-        generate_store_var(tables.back()->rbp, offset, new_exp->erekhBituy);
-    } else {
-        generate_store_var(tables.current_scope()->rbp, offset, exp->erekhBituy);
-    }
-}
-
-/*
-// Generates llvm code of initializing a variable in FanC
-void LLVM_code_generator::InitializeIntVariableConvertor(Num numExpression, int value)
-{
-    // numExpression = "int x = 5";
-    string registerName = buff.freshVar(); // t0  t1 t2
-    NumVariable newVariable;
-    newVariable.variable_name = numExpression.erekhBituy; // newVariable.variable_name = x
-    if (numExpression.erekhMispar != NULL)
-    {
-        newVariable.variable_value = numExpression.erekhMispar;
-    }
-    else // int x;
-    {
-        newVariable.variable_value = 0; // default value, approppiate case for int x;
-    }
-    variablesStack
-}
-
-void LLVM_code_generator::InitializeBoolVariableConvertor(Exp* boolExpression, bool value)
-{
-    // bool flag = false;
-    string varName = buff.freshLabel();
-    varName = boolExpression->erekhBituy;
-    if (boolExpression->erekhMispar != NULL)
-    {
-        value = boolExpression->erekhMispar;
-    }
-    else
-    {
-        value = false; // default value, approppiate case for bool flag;
-    }
-}
-
-void LLVM_code_generator::storeVariable(string& basePointer, int offset, string& registerName)
-{
-
-    string registerPtr = buff.freshVar();
-
-} */
+#include "generator.hpp"
+
+LLVM_code_generator::LLVM_code_generator(output::CodeBuffer &buffer, ir::InlineLibrary *library,
+                                         ir::PassReport *report)
+        : buffer(buffer), library(library), report(report) {}
+
+void LLVM_code_generator::inlineFrom(ir::InlineLibrary *library) {
+    this->library = library;
+}
+
+ir::Type LLVM_code_generator::irType(BuiltInType type) {
+    switch (type) {
+        case VOID:
+            return ir::Type::VOID;
+        case STRING:
+            return ir::Type::I8_PTR;
+        default:
+            // int, byte and bool all travel as i32 between functions
+            return ir::Type::I32;
+    }
+}
+
+void LLVM_code_generator::append(ir::Instruction *instruction) {
+    if (nigmarBlock) {
+        // Code after return/break/continue is unreachable, but it still has to live in a block
+        emitLabel();
+    }
+    current->append(instruction);
+}
+
+ir::Value LLVM_code_generator::define(ir::Opcode op, ir::Type type, std::initializer_list<ir::Value> ops,
+                                      ir::Predicate pred) {
+    ir::Value folded;
+    if (std::all_of(ops.begin(), ops.end(), [](const ir::Value &op) { return op.isConst(); }) &&
+        ir::fold(op, type, pred, ops.begin(), folded)) {
+        return folded;
+    }
+    ir::Value res = function->newReg(type);
+    ir::Instruction *instruction = function->create(op, type, res.n, ops);
+    instruction->pred = pred;
+    append(instruction);
+    return res;
+}
+
+void LLVM_code_generator::terminate(ir::Instruction *instruction) {
+    append(instruction);
+    nigmarBlock = true;
+}
+
+ir::Block *LLVM_code_generator::emitLabel() {
+    ir::Block *label = function->newBlock();
+    if (!nigmarBlock) {
+        current->append(function->create(ir::Opcode::BR, ir::Type::VOID, -1, {}, {label}));
+    }
+    function->place(label);
+    current = label;
+    nigmarBlock = false;
+    return label;
+}
+
+void LLVM_code_generator::branch(ir::Block *label) {
+    terminate(function->create(ir::Opcode::BR, ir::Type::VOID, -1, {}, {label}));
+}
+
+void LLVM_code_generator::branch(ir::PatchList &next) {
+    ir::Instruction *br = function->create(ir::Opcode::BR, ir::Type::VOID, -1, {}, {nullptr});
+    terminate(br);
+    next.push_back({br, 0});
+}
+
+void LLVM_code_generator::cond_branch(ir::Value cond, ir::PatchList &trueList, ir::PatchList &falseList) {
+    ir::Instruction *br = function->create(ir::Opcode::CONDBR, ir::Type::VOID, -1, {cond}, {nullptr, nullptr});
+    terminate(br);
+    trueList.push_back({br, 0});
+    falseList.push_back({br, 1});
+}
+
+ir::Block *LLVM_code_generator::currentLabel() const {
+    return current;
+}
+
+void LLVM_code_generator::globalFunctions() {
+    buffer.emit("declare i32 @printf(i8*, ...)");
+    buffer.emit("declare void @exit(i32)");
+    buffer.emit("@.int_specifier = constant [4 x i8] c\"%d\\0A\\00\"");
+    buffer.emit("@.str_specifier = constant [4 x i8] c\"%s\\0A\\00\"");
+    buffer.emit("define void @printi(i32) {");
+    buffer.emit("%spec_ptr = getelementptr [4 x i8], [4 x i8]* @.int_specifier, i32 0, i32 0");
+    buffer.emit("call i32 (i8*, ...) @printf(i8* %spec_ptr, i32 %0)");
+    buffer.emit("ret void");
+    buffer.emit("}");
+    buffer.emit("define void @print(i8*) {");
+    buffer.emit("%spec_ptr = getelementptr [4 x i8], [4 x i8]* @.str_specifier, i32 0, i32 0");
+    buffer.emit("call i32 (i8*, ...) @printf(i8* %spec_ptr, i8* %0)");
+    buffer.emit("ret void");
+    buffer.emit("}");
+    // The error blocks of the division checks print this message, see lowerDivisionChecks
+    buffer.emit("@.DIV_BY_ZERO_ERROR = internal constant [23 x i8] c\"Error division by zero\\00\"");
+}
+
+ir::Value LLVM_code_generator::generate_load_var(ir::Value ktovet) {
+    return define(ir::Opcode::LOAD, ktovet.type == ir::Type::I8_PTR ? ir::Type::I8 : ir::Type::I32, {ktovet});
+}
+
+void LLVM_code_generator::generate_store_var(ir::Value ktovet, ir::Value reg) {
+    append(function->create(ir::Opcode::STORE, ir::Type::VOID, -1, {reg, ktovet}));
+}
+
+ir::Value LLVM_code_generator::alloca_var(ir::Type type) {
+    ir::Type pointer = type == ir::Type::I8 ? ir::Type::I8_PTR : ir::Type::I32_PTR;
+    ir::Value ktovet = function->newReg(pointer);
+    ir::Instruction *alloca = function->create(ir::Opcode::ALLOCA, pointer, ktovet.n, {});
+    // All the allocas stay at the top of the entry block, where mem2reg expects them
+    ir::Block *entry = function->first;
+    ir::Instruction *pos = hakatsaaAharona ? hakatsaaAharona->next : entry->first;
+    if (pos) {
+        entry->insertBefore(pos, alloca);
+    } else {
+        entry->append(alloca);
+    }
+    hakatsaaAharona = alloca;
+    return ktovet;
+}
+
+ir::Value LLVM_code_generator::binop_code(BuiltInType type, ir::Value operand1, ir::Value operand2, BinOpType op) {
+    ir::Opcode opcode;
+    switch (op) {
+        case ADD:
+            opcode = ir::Opcode::ADD;
+            break;
+        case SUB:
+            opcode = ir::Opcode::SUB;
+            break;
+        case MUL:
+            opcode = ir::Opcode::MUL;
+            break;
+        default:
+            opcode = type == INT ? ir::Opcode::SDIV : ir::Opcode::UDIV;
+            break;
+    }
+    // Both operands of a byte operation are bytes, and i8 arithmetic wraps around at 256 by itself
+    ir::Type resultType = ir::Type::I8;
+    if (type == INT) {
+        resultType = ir::Type::I32;
+        operand1 = widen(operand1);
+        operand2 = widen(operand2);
+    }
+    if (op == DIV) {
+        // Not a function of the runtime: the passes remove the check or lower it into a branch to an error block
+        ir::Instruction *check = function->create(ir::Opcode::CALL, ir::Type::VOID, -1, {operand2});
+        check->callee = "check_division";
+        append(check);
+    }
+    return define(opcode, resultType, {operand1, operand2});
+}
+
+ir::Value LLVM_code_generator::relop_code(ir::Value operand1, ir::Value operand2, RelOpType op) {
+    ir::Predicate pred;
+    switch (op) {
+        case EQ:
+            pred = ir::Predicate::EQ;
+            break;
+        case NE:
+            pred = ir::Predicate::NE;
+            break;
+        case GT:
+            pred = ir::Predicate::SGT;
+            break;
+        case GE:
+            pred = ir::Predicate::SGE;
+            break;
+        case LT:
+            pred = ir::Predicate::SLT;
+            break;
+        default:
+            pred = ir::Predicate::SLE;
+            break;
+    }
+    return define(ir::Opcode::ICMP, ir::Type::I1, {widen(operand1), widen(operand2)}, pred);
+}
+
+ir::Value LLVM_code_generator::cast_code(BuiltInType from, BuiltInType to, ir::Value reg) {
+    if (from == INT && to == BYTE) {
+        return define(ir::Opcode::TRUNC, ir::Type::I8, {reg});
+    }
+    if (to == INT) {
+        return widen(reg);
+    }
+    return reg;
+}
+
+ir::Value LLVM_code_generator::string_code(const string &value) {
+    // The printer emits the constant and its size, the instruction only refers to it by index
+    function->strings.push_back(value);
+    return define(ir::Opcode::STRING, ir::Type::I8_PTR, {ir::Value::constant(function->strings.size() - 1)});
+}
+
+ir::Value LLVM_code_generator::not_code(ir::Value reg) {
+    if (reg.isConst()) {
+        return ir::Value::constant(!reg.n, ir::Type::I1);
+    }
+    ir::Instruction *last = current->last;
+    if (reg.isReg() && !nigmarBlock && last && last->result == reg.n && last->op == ir::Opcode::ICMP) {
+        // The comparison was just made for this operand and has no other use, so compare the other way instead
+        static const ir::Predicate inverse[] = {ir::Predicate::NONE, ir::Predicate::NE, ir::Predicate::EQ,
+                                                ir::Predicate::SLE, ir::Predicate::SLT, ir::Predicate::SGE,
+                                                ir::Predicate::SGT};
+        last->pred = inverse[(int) last->pred];
+        return reg;
+    }
+    return define(ir::Opcode::XOR, ir::Type::I1, {reg, ir::Value::constant(1, ir::Type::I1)});
+}
+
+ir::Value LLVM_code_generator::bool_to_i32(ir::Value reg) {
+    return define(ir::Opcode::ZEXT, ir::Type::I32, {reg});
+}
+
+ir::Value LLVM_code_generator::i32_to_bool(ir::Value reg) {
+    return define(ir::Opcode::ICMP, ir::Type::I1, {reg, ir::Value::constant(0)}, ir::Predicate::NE);
+}
+
+ir::Value LLVM_code_generator::widen(ir::Value reg) {
+    if (reg.type != ir::Type::I8) {
+        return reg;
+    }
+    return define(ir::Opcode::ZEXT, ir::Type::I32, {reg});
+}
+
+ir::Value LLVM_code_generator::call_code(BuiltInType returnType, const string &name, const vector<BuiltInType> &types,
+                                         const vector<ir::Value> &regs) {
+    vector<ir::Value> args;
+    for (size_t i = 0; i < regs.size(); i++) {
+        args.push_back(types[i] == BOOL ? bool_to_i32(regs[i]) : widen(regs[i]));
+    }
+    ir::Value res;
+    if (returnType != VOID) {
+        res = function->newReg(ir::Type::I32);
+    }
+    ir::Instruction *call = function->create(ir::Opcode::CALL, irType(returnType), returnType == VOID ? -1 : res.n,
+                                             args);
+    call->callee = function->arena.copy(name);
+    append(call);
+    if (returnType == BOOL) {
+        return i32_to_bool(res);
+    }
+    if (returnType == BYTE) {
+        return define(ir::Opcode::TRUNC, ir::Type::I8, {res});
+    }
+    return res;
+}
+
+void LLVM_code_generator::jump_code(ir::Value cond, ir::PatchList &trueList, ir::PatchList &falseList) {
+    if (cond.isConst()) {
+        branch(cond.n ? trueList : falseList);
+    } else {
+        cond_branch(cond, trueList, falseList);
+    }
+}
+
+void LLVM_code_generator::bool_jump_begin(bool is_and, ir::PatchList &trueList, ir::PatchList &falseList) {
+    ir::PatchList &rhsList = is_and ? trueList : falseList;
+    ir::backpatch(rhsList, emitLabel());
+    rhsList.clear();
+}
+
+ir::Value LLVM_code_generator::materialize(ir::PatchList &trueList, ir::PatchList &falseList) {
+    ir::Block *join = emitLabel();
+    vector<ir::Value> values;
+    vector<ir::Block *> preds;
+    for (int emet = 1; emet >= 0; emet--) {
+        for (const ir::Hole &hole: emet ? trueList : falseList) {
+            ir::Instruction *br = hole.branch;
+            if (hole.index >= br->numTargets || br->targets[hole.index] == join) {
+                // The other target of a branch that was already turned into a jump below
+                continue;
+            }
+            ir::Value value = ir::Value::constant(emet, ir::Type::I1);
+            if (br->op == ir::Opcode::CONDBR && br->targets[1 - hole.index] == nullptr) {
+                // Both targets of the branch lead here, so the incoming value is its condition (or its negation)
+                value = br->ops[0];
+                if ((hole.index == 0) != (emet == 1)) {
+                    ir::Value inverted = function->newReg(ir::Type::I1);
+                    br->block->insertBefore(br, function->create(ir::Opcode::XOR, ir::Type::I1, inverted.n,
+                                                                 {value, ir::Value::constant(1, ir::Type::I1)}));
+                    value = inverted;
+                }
+                br->op = ir::Opcode::BR;
+                br->numOps = 0;
+                br->numTargets = 1;
+            }
+            br->targets[br->op == ir::Opcode::BR ? 0 : hole.index] = join;
+            values.push_back(value);
+            preds.push_back(br->block);
+        }
+    }
+    trueList.clear();
+    falseList.clear();
+    ir::Value res = function->newReg(ir::Type::I1);
+    append(function->create(ir::Opcode::PHI, ir::Type::I1, res.n, values, preds));
+    return res;
+}
+
+void LLVM_code_generator::function_begin(const string &name, BuiltInType returnType,
+                                         const vector<BuiltInType> &paramTypes) {
+    vector<ir::Type> params;
+    for (BuiltInType type: paramTypes) {
+        params.push_back(irType(type));
+    }
+    function.reset(new ir::Function(name, irType(returnType), params));
+    this->returnType = returnType;
+    hakatsaaAharona = nullptr;
+    nigmarBlock = true;
+    emitLabel();
+}
+
+void LLVM_code_generator::count(const char *pass, const ir::Function &function) {
+    if (report) {
+        report->add(pass, function);
+    }
+}
+
+void LLVM_code_generator::run(const char *pass, void (*body)(ir::Function &), ir::Function &function) {
+    body(function);
+    count(pass, function);
+}
+
+void LLVM_code_generator::function_end() {
+    if (!nigmarBlock) {
+        return_code(INT, default_value(INT));
+    }
+    count("lowered", *function);
+    run("ssa", ir::buildSsa, *function);
+    run("tail recursion", ir::eliminateTailRecursion, *function);
+    current = nullptr;
+}
+
+std::shared_ptr<ir::Function> LLVM_code_generator::releaseFunction() {
+    return std::move(function);
+}
+
+void LLVM_code_generator::optimize(const std::shared_ptr<ir::Function> &function) {
+    if (library) {
+        ir::inlineCalls(*function, *library);
+        count("inline", *function);
+    }
+    run("sccp", ir::propagateConstants, *function);
+    run("simplifycfg", ir::simplifyCfg, *function);
+    run("masks", ir::removeMasks, *function);
+    run("division checks", ir::removeDivisionChecks, *function);
+    run("rotate loops", ir::rotateLoops, *function);
+    // Rotation leaves phis of one value, and the blocks behind a test it found constant
+    run("simplifycfg after rotation", ir::simplifyCfg, *function);
+    run("lower division checks", ir::lowerDivisionChecks, *function);
+    run("hoist invariants", ir::hoistInvariants, *function);
+    run("peephole", ir::peephole, *function);
+    // The diamonds the peephole folded leave branches whose arms meet again with nothing to do
+    run("simplifycfg after peephole", ir::simplifyCfg, *function);
+    ir::markTailCalls(*function);
+    if (library) {
+        library->add(function);
+    }
+}
+
+void LLVM_code_generator::return_code(BuiltInType expType, ir::Value reg) {
+    if (returnType == VOID) {
+        terminate(function->create(ir::Opcode::RET, ir::Type::VOID, -1, {}));
+    } else {
+        ir::Value res = expType == BOOL ? bool_to_i32(reg) : widen(reg);
+        terminate(function->create(ir::Opcode::RET, ir::Type::VOID, -1, {res}));
+    }
+}
+
+ir::Value LLVM_code_generator::default_value(BuiltInType type) {
+    return ir::Value::constant(0, type == BOOL ? ir::Type::I1 : type == BYTE ? ir::Type::I8 : ir::Type::I32);
+}
+
+void LLVM_code_generator::beginScope() {
+    tsvaim.emplace_back();
+}
+
+void LLVM_code_generator::endScope() {
+    tsvaim.pop_back();
+}
+
+const LLVM_code_generator::MishtaneBaMisgeret *LLVM_code_generator::lookup(const string &shem) const {
+    for (auto tsav = tsvaim.rbegin(); tsav != tsvaim.rend(); ++tsav) {
+        for (const MishtaneBaMisgeret &mishtane: *tsav) {
+            if (mishtane.shem == shem) {
+                return &mishtane;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void LLVM_code_generator::declare_param(const string &shem, BuiltInType type) {
+    // Parameters are declared in order, first in the function's scope
+    ir::Value param = function->param(tsvaim.back().size());
+    tsvaim.back().push_back({shem, type, alloca_var(type == BYTE ? ir::Type::I8 : ir::Type::I32)});
+    if (type == BYTE) {
+        param = define(ir::Opcode::TRUNC, ir::Type::I8, {param});
+    }
+    generate_store_var(tsvaim.back().back().ktovet, param);
+}
+
+void LLVM_code_generator::declare_var(const string &shem, BuiltInType type, ir::Value reg) {
+    tsvaim.back().push_back({shem, type, alloca_var(type == BYTE ? ir::Type::I8 : ir::Type::I32)});
+    store_code(tsvaim.back().back(), reg);
+}
+
+ir::Value LLVM_code_generator::load_code(const MishtaneBaMisgeret &mishtane) {
+    ir::Value reg = generate_load_var(mishtane.ktovet);
+    if (mishtane.type == BOOL) {
+        return i32_to_bool(reg);
+    }
+    return reg;
+}
+
+void LLVM_code_generator::store_code(const MishtaneBaMisgeret &mishtane, ir::Value reg) {
+    if (mishtane.type == BOOL) {
+        generate_store_var(mishtane.ktovet, bool_to_i32(reg));
+    } else if (mishtane.type == INT) {
+        generate_store_var(mishtane.ktovet, widen(reg));
+    } else {
+        generate_store_var(mishtane.ktovet, reg);
+    }
+}
+
+void LLVM_code_generator::loop_begin(ir::Block *condLabel) {
+    lulaot.emplace_back(condLabel, ir::PatchList());
+}
+
+ir::PatchList LLVM_code_generator::loop_end() {
+    ir::PatchList breaks = std::move(lulaot.back().second);
+    lulaot.pop_back();
+    return breaks;
+}
+
+bool LLVM_code_generator::inside_loop() const {
+    return !lulaot.empty();
+}
+
+void LLVM_code_generator::break_code() {
+    branch(lulaot.back().second);
+}
+
+void LLVM_code_generator::continue_code() {
+    branch(lulaot.back().first);
+}
+
+void LLVM_code_generator::visitInScope(ast::Statement &statement) {
+    if (statement.zeSograyim) {
+        beginScope();
+        statement.accept(*this);
+        endScope();
+    } else {
+        statement.accept(*this);
+    }
+}
+
+void LLVM_code_generator::visit(ast::Num &node) {
+    node.erekhBituy = ir::Value::constant(node.value);
+}
+
+void LLVM_code_generator::visit(ast::NumB &node) {
+    node.erekhBituy = ir::Value::constant(node.value, ir::Type::I8);
+}
+
+void LLVM_code_generator::visit(ast::String &node) {
+    node.erekhBituy = string_code(node.value);
+}
+
+void LLVM_code_generator::visit(ast::Bool &node) {
+    node.erekhBituy = ir::Value::constant(node.value, ir::Type::I1);
+}
+
+void LLVM_code_generator::visit(ast::ID &node) {
+    node.erekhBituy = load_code(*lookup(node.value));
+}
+
+void LLVM_code_generator::visit(ast::BinOp &node) {
+    node.left->accept(*this);
+    node.right->accept(*this);
+    node.erekhBituy = binop_code(node.type, node.left->erekhBituy, node.right->erekhBituy, node.op);
+}
+
+void LLVM_code_generator::visit(ast::RelOp &node) {
+    node.left->accept(*this);
+    node.right->accept(*this);
+    node.erekhBituy = relop_code(node.left->erekhBituy, node.right->erekhBituy, node.op);
+}
+
+void LLVM_code_generator::visit(ast::Not &node) {
+    if (is_jumping(*node.exp)) {
+        ir::PatchList trueList, falseList;
+        condition(node, trueList, falseList);
+        node.erekhBituy = materialize(trueList, falseList);
+        return;
+    }
+    node.exp->accept(*this);
+    node.erekhBituy = not_code(node.exp->erekhBituy);
+}
+
+void LLVM_code_generator::visit(ast::And &node) {
+    ir::PatchList trueList, falseList;
+    condition(node, trueList, falseList);
+    node.erekhBituy = materialize(trueList, falseList);
+}
+
+void LLVM_code_generator::visit(ast::Or &node) {
+    ir::PatchList trueList, falseList;
+    condition(node, trueList, falseList);
+    node.erekhBituy = materialize(trueList, falseList);
+}
+
+bool LLVM_code_generator::is_jumping(ast::Exp &exp) {
+    if (dynamic_cast<ast::And *>(&exp) || dynamic_cast<ast::Or *>(&exp)) {
+        return true;
+    }
+    ast::Not *node = dynamic_cast<ast::Not *>(&exp);
+    return node && is_jumping(*node->exp);
+}
+
+void LLVM_code_generator::condition(ast::Exp &exp, ir::PatchList &trueList, ir::PatchList &falseList) {
+    ast::And *andNode = dynamic_cast<ast::And *>(&exp);
+    ast::Or *orNode = dynamic_cast<ast::Or *>(&exp);
+    if (andNode || orNode) {
+        // The operands get lists of their own, so that starting the right operand patches only the left one's jumps
+        ir::PatchList operandTrue, operandFalse;
+        condition(andNode ? *andNode->left : *orNode->left, operandTrue, operandFalse);
+        bool_jump_begin(andNode != nullptr, operandTrue, operandFalse);
+        condition(andNode ? *andNode->right : *orNode->right, operandTrue, operandFalse);
+        ir::merge(trueList, operandTrue);
+        ir::merge(falseList, operandFalse);
+    } else if (is_jumping(exp)) {
+        // A negated condition is the same jumps with the lists swapped
+        condition(*dynamic_cast<ast::Not &>(exp).exp, falseList, trueList);
+    } else {
+        exp.accept(*this);
+        jump_code(exp.erekhBituy, trueList, falseList);
+    }
+}
+
+void LLVM_code_generator::visit(ast::Type &) {
+}
+
+void LLVM_code_generator::visit(ast::Cast &node) {
+    node.exp->accept(*this);
+    node.erekhBituy = cast_code(node.exp->type, node.target_type->type, node.exp->erekhBituy);
+}
+
+void LLVM_code_generator::visit(ast::ExpList &node) {
+    for (auto &exp: node.exps) {
+        exp->accept(*this);
+    }
+}
+
+void LLVM_code_generator::visit(ast::Call &node) {
+    node.args->accept(*this);
+    vector<BuiltInType> types;
+    vector<ir::Value> regs;
+    for (auto &exp: node.args->exps) {
+        types.push_back(exp->type);
+        regs.push_back(exp->erekhBituy);
+    }
+    node.erekhBituy = call_code(node.type, node.func_id->value, types, regs);
+}
+
+void LLVM_code_generator::visit(ast::Statements &node) {
+    for (auto &statement: node.statements) {
+        visitInScope(*statement);
+    }
+}
+
+void LLVM_code_generator::visit(ast::Break &) {
+    break_code();
+}
+
+void LLVM_code_generator::visit(ast::Continue &) {
+    continue_code();
+}
+
+void LLVM_code_generator::visit(ast::Return &node) {
+    if (node.exp) {
+        node.exp->accept(*this);
+        return_code(node.exp->type, node.exp->erekhBituy);
+    } else {
+        return_code(VOID, ir::Value());
+    }
+}
+
+void LLVM_code_generator::visit(ast::If &node) {
+    // Blocks are started in the same order as the single-pass parser starts them
+    ir::PatchList trueList, falseList;
+    beginScope();
+    condition(*node.condition, trueList, falseList);
+    ir::backpatch(trueList, emitLabel());
+    visitInScope(*node.then);
+    endScope();
+
+    if (node.otherwise) {
+        ir::PatchList nextList;
+        branch(nextList);
+        ir::backpatch(falseList, emitLabel());
+        beginScope();
+        visitInScope(*node.otherwise);
+        endScope();
+        ir::backpatch(nextList, emitLabel());
+    } else {
+        ir::backpatch(falseList, emitLabel());
+    }
+}
+
+void LLVM_code_generator::visit(ast::While &node) {
+    ir::PatchList trueList, falseList;
+    beginScope();
+    ir::Block *condLabel = emitLabel();
+    condition(*node.condition, trueList, falseList);
+    ir::backpatch(trueList, emitLabel());
+    loop_begin(condLabel);
+    visitInScope(*node.body);
+    ir::PatchList breaks = loop_end();
+    branch(condLabel);
+    endScope();
+    ir::Block *endLabel = emitLabel();
+    ir::backpatch(falseList, endLabel);
+    ir::backpatch(breaks, endLabel);
+}
+
+void LLVM_code_generator::visit(ast::VarDecl &node) {
+    // Uninitialized variables start as 0 / false
+    ir::Value reg = default_value(node.type->type);
+    if (node.init_exp) {
+        node.init_exp->accept(*this);
+        reg = node.init_exp->erekhBituy;
+    }
+    declare_var(node.id->value, node.type->type, reg);
+}
+
+void LLVM_code_generator::visit(ast::Assign &node) {
+    node.exp->accept(*this);
+    store_code(*lookup(node.id->value), node.exp->erekhBituy);
+}
+
+void LLVM_code_generator::visit(ast::Formal &node) {
+    declare_param(node.id->value, node.type->type);
+}
+
+void LLVM_code_generator::visit(ast::Formals &node) {
+    for (auto &formal: node.formals) {
+        formal->accept(*this);
+    }
+}
+
+void LLVM_code_generator::visit(ast::FuncDecl &node) {
+    vector<BuiltInType> paramTypes;
+    for (auto &formal: node.formals->formals) {
+        paramTypes.push_back(formal->type->type);
+    }
+    function_begin(node.id->value, node.return_type->type, paramTypes);
+    beginScope();
+    node.formals->accept(*this);
+    node.body->accept(*this);
+    endScope();
+    function_end();
+}
+
+void LLVM_code_generator::visit(ast::Funcs &node) {
+    globalFunctions();
+    output::StringPool pool(buffer);
+    for (auto &func: node.funcs) {
+        func->accept(*this);
+        std::shared_ptr<ir::Function> function = releaseFunction();
+        optimize(function);
+        ir::print(*function, buffer, pool);
+    }
+}
+
+/*
+// Generates llvm code of initializing a variable in FanC
+void LLVM_code_generator::InitializeIntVariableConvertor(Num numExpression, int value)
+{
+    // numExpression = "int x = 5";
+    string registerName = buff.freshVar(); // t0  t1 t2
+    NumVariable newVariable;
+    newVariable.variable_name = numExpression.erekhBituy; // newVariable.variable_name = x
+    if (numExpression.erekhMispar != NULL)
+    {
+        newVariable.variable_value = numExpression.erekhMispar;
+    }
+    else // int x;
+    {
+        newVariable.variable_value = 0; // default value, approppiate case for int x;
+    }
+    variablesStack
+}
+
+void LLVM_code_generator::InitializeBoolVariableConvertor(Exp* boolExpression, bool value)
+{
+    // bool flag = false;
+    string varName = buff.freshLabel();
+    varName = boolExpression->erekhBituy;
+    if (boolExpression->erekhMispar != NULL)
+    {
+        value = boolExpression->erekhMispar;
+    }
+    else
+    {
+        value = false; // default value, approppiate case for bool flag;
+    }
+}
+
+void LLVM_code_generator::storeVariable(string& basePointer, int offset, string& registerName)
+{
+
+    string registerPtr = buff.freshVar();
+
+} */
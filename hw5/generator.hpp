@@ -1,127 +1,282 @@
-#ifndef _GENERATOR_HPP_
-#define _GENERATOR_HPP_
-#include "hw5-supplied/output.hpp"
-#include "outputAndSymbolTable.hpp"
-#include <vector>
-using namespace std;
-using namespace ast;
-
-using std::string;
-
-// template <typename T>
-class LLVM_code_generator {
-  public:
-    void globalFunctions();
-    string generate_load_var(string rbp, int offset);
-    void generate_store_var(string rbp, int offset, string reg);
-    void binop_code(Exp *res, const Exp &operand1, const Exp &operand2, const string &op);
-    void relop_code(Exp *res, const Exp *operand1, const Exp *operand2, const string &op);
-    void bool_eval_code(Exp *res, const Exp *operand1, const Exp *operand2, const string &op, const string &label);
-    void assign_code(Exp *exp, int offset, bool is_bool);
-
-    /*
-     output::CodeBuffer buff;
-    vector<T> variablesStack;
-    void InitializeIntVariableConvertor(Num numExpression);
-    void InitializeBoolVariableConvertor(Bool boolExpression);
-    void LoadVariableFromStack(Binop expression)
-    void StoreVariableInStack()
-    //void storeVariable(string& basePointer, int offset, string& registerName);
-    void AccessToVariableConvertor();
-    void ArithmeticExpressionConvertor();
-    void NumericOverflowConvertor();
-    void BooleanExpressionConvertor();
-    void FunctionCallConvertor();
-    void IfConvertor();
-    void WhileConvertor();
-    void BreakConvertor();
-    void ContinueConvertor();
-    void ReturnConvertor();
-    void LibraryFunctionsConvertor();
-    void PrintiConvertor(); // Mind the i
-    void PrintConvertor(); // Mind the lack of i
-    void ErrorConvertor(); // not sure */
-};
-
-/* class NumVariable{
-    public:
-        string variable_name;
-        int variable_value;
-        string registerName;
-};
-
-class BoolVariable{
-    public:
-        string variable_name;
-        bool variable_value;
-        string registerName;
-};
-
-
-template <typename T>
-// Generates llvm code of initializing a variable in FanC
-void LLVM_code_generator<T>::InitializeIntVariableConvertor(Num numExpression)
-{
-    // numExpression = "int x = 5"; int x = 4 + y;
-    NumVariable newNumVariable;
-    newNumVariable.registerName = buff.freshVar(); // t0  t1 t2
-    newNumVariable.variable_name = numExpression.erekhBituy; // newVariable.variable_name = x
-    if (numExpression.erekhMispar != NULL)
-    {
-        newNumVariable.variable_value = numExpression.erekhMispar;
-    }
-    else // int x;
-    {
-        newNumVariable.variable_value = 0; // default value, approppiate case for int x;
-    }
-    variablesStack.push_back(newNumVariable);
-    buff.emit(newNumVariable.registerName + " = add i32 " +  to_string(variable_value) + ", 0");
-}
-
-template <typename T>
-void LLVM_code_generator<T>::InitializeBoolVariableConvertor(Bool boolExpression)
-{
-    // bool flag = false;
-    BoolVariable newBoolVariable;
-    newBoolVariable.registerName = buff.freshLabel(); // registerName = %t2
-    newBoolVariable.variable_name = boolExpression->erekhBituy; // newBoolVariable.variable_name = flag
-    if (boolExpression->erekhMispar != NULL)
-    {
-        newBoolVariable.variable_value = boolExpression->erekhMispar; // newBoolVariable.variable_value = 0
-    }
-    else
-    {
-        newBoolVariable.variable_value = false; // default value, approppiate case for bool flag;
-    }
-    variablesStack.push_back(newBoolVariable); // push([variable_name, variable_value])
-    buff.emit(newBoolVariable.registerName + " = add i32 " +  to_string(variable_value) + ", 0"); // buff.emit(%t2 = add i32 0, 0)
-}
-
-template <typename T>
-void LLVM_code_generator<T>::LoadVariableFromStack(Binop expression)
-{
-    string newRegisterName;
-    // int y = x + 3;
-    // %y = load i32, i32* %x --> y = x
-    // %y = add i32 %y, 3
-    for (int i = 0;variablesStack.size();i++)
-    {
-        if (variablesStack<NumVariable>[i]->variable_name == expression.leftHandSide.erekhBituy) // we found the FanC variable x in the stack
-        {
-            newRegisterName = buff.freshVar();
-            buff.emit(newRegisterName + " = load i32, i32* " + variablesStack[i].registerName);
-            buff.emit(newRegisterName + " = add i32 " +  newRegisterName + ", " + expression.rightHandSide); // buff.emit(%t2 = add i32 0, 0)
-        }
-    }
-}
-
-
-void LLVM_code_generator::storeVariable(string& basePointer, int offset, string& registerName)
-{
-
-    string registerPtr = buff.freshVar();
-
-}
-*/
-
-#endif
+#ifndef _GENERATOR_HPP_
+#define _GENERATOR_HPP_
+#include "hw5-supplied/output.hpp"
+#include "outputAndSymbolTable.hpp"
+#include "ir.hpp"
+#include "passes.hpp"
+#include "inliner.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
+using namespace std;
+using namespace ast;
+
+using std::string;
+
+// template <typename T>
+class LLVM_code_generator : public Visitor {
+  public:
+    // A local variable or a parameter of the current function, each has an alloca of its own: i8 for a byte, i32
+    // otherwise
+    struct MishtaneBaMisgeret {
+        string shem;
+        BuiltInType type;
+        ir::Value ktovet;
+    };
+
+  private:
+    // The buffer of the compilation this generator belongs to
+    output::CodeBuffer &buffer;
+    // Scopes of the current function, innermost last
+    vector<vector<MishtaneBaMisgeret>> tsvaim;
+    // The last alloca at the top of the entry block, new ones go after it
+    ir::Instruction *hakatsaaAharona = nullptr;
+    // IR of the function being lowered, until it is released after its passes
+    std::shared_ptr<ir::Function> function;
+    // The finished functions the calls may inline, nullptr to inline none
+    ir::InlineLibrary *library = nullptr;
+    // Counts the instructions after every pass, nullptr to count none
+    ir::PassReport *report = nullptr;
+    // The basic block currently being filled
+    ir::Block *current = nullptr;
+    // Return type of the current function
+    BuiltInType returnType = VOID;
+    // Continue target and pending break jumps of the enclosing loops, innermost last
+    vector<pair<ir::Block *, ir::PatchList>> lulaot;
+    // True after a terminator was emitted and before the next label
+    bool nigmarBlock = false;
+
+  public:
+    explicit LLVM_code_generator(output::CodeBuffer &buffer, ir::InlineLibrary *library = nullptr,
+                                 ir::PassReport *report = nullptr);
+
+    // Inlines from the library, which every finished function is added to
+    void inlineFrom(ir::InlineLibrary *library);
+
+    /* Emission helpers.
+     * These are shared by the AST visitor below and by the single-pass parser (onepass/parser.y),
+     * so both front ends produce the same instructions for the same construct.
+     * Values are registers or constants of the current function; names are only formatted by the printer.
+     */
+
+    // Starts a new basic block, falling through into it from the current one if needed, and returns it
+    ir::Block *emitLabel();
+    // Closes the current block with a jump to a block that already exists
+    void branch(ir::Block *label);
+    // Closes the current block with jumps whose targets are added to the lists, to be backpatched later
+    void branch(ir::PatchList &next);
+    void cond_branch(ir::Value cond, ir::PatchList &trueList, ir::PatchList &falseList);
+    // The basic block currently being filled, used for phi operands
+    ir::Block *currentLabel() const;
+
+    void globalFunctions();
+    ir::Value generate_load_var(ir::Value ktovet);
+    void generate_store_var(ir::Value ktovet, ir::Value reg);
+    ir::Value binop_code(BuiltInType type, ir::Value operand1, ir::Value operand2, BinOpType op);
+    ir::Value relop_code(ir::Value operand1, ir::Value operand2, RelOpType op);
+    ir::Value cast_code(BuiltInType from, BuiltInType to, ir::Value reg);
+    ir::Value string_code(const string &value);
+    ir::Value not_code(ir::Value reg);
+    ir::Value call_code(BuiltInType returnType, const string &name, const vector<BuiltInType> &types,
+                        const vector<ir::Value> &regs);
+    // Converts an i1 to its i32 storage form and back
+    ir::Value bool_to_i32(ir::Value reg);
+    ir::Value i32_to_bool(ir::Value reg);
+    // Bytes are i8 within a function; an i8 is zero extended where it meets an int, and at calls and returns
+    ir::Value widen(ir::Value reg);
+    /* Jumping code: a condition is lowered to branches whose true and false targets wait in two lists.
+     * and/or/not only combine the lists, so a condition never builds an i1 that is branched on again;
+     * a bool value is joined from the lists with a phi only where one is stored, passed or returned.
+     */
+    // Branches on a value, or jumps straight into one of the lists for a constant
+    void jump_code(ir::Value cond, ir::PatchList &trueList, ir::PatchList &falseList);
+    // Starts the right operand of and/or: the left operand's true (and) / false (or) jumps lead to it
+    void bool_jump_begin(bool is_and, ir::PatchList &trueList, ir::PatchList &falseList);
+    ir::Value materialize(ir::PatchList &trueList, ir::PatchList &falseList);
+    void function_begin(const string &name, BuiltInType returnType, const vector<BuiltInType> &paramTypes);
+    // Ends the function and runs the passes that only need the function itself, it is then released to be optimized
+    void function_end();
+    std::shared_ptr<ir::Function> releaseFunction();
+    // Runs the other passes on a released function, inlining the finished functions of the library into it, and adds
+    // it to the library. The functions before it in the library's order are optimized first, or on other threads
+    void optimize(const std::shared_ptr<ir::Function> &function);
+    void return_code(BuiltInType expType, ir::Value reg);
+    // Value of a variable declared without an initializer: 0 / false
+    static ir::Value default_value(BuiltInType type);
+
+    // Symbol table of the current function
+    void beginScope();
+    void endScope();
+    // Returns nullptr for names that are not variables in scope
+    const MishtaneBaMisgeret *lookup(const string &shem) const;
+    void declare_param(const string &shem, BuiltInType type);
+    void declare_var(const string &shem, BuiltInType type, ir::Value reg);
+    ir::Value load_code(const MishtaneBaMisgeret &mishtane);
+    void store_code(const MishtaneBaMisgeret &mishtane, ir::Value reg);
+
+    // Loops: continue jumps to the condition block, break jumps are collected until the loop exit exists
+    void loop_begin(ir::Block *condLabel);
+    // Returns the break jumps of the loop
+    ir::PatchList loop_end();
+    bool inside_loop() const;
+    void break_code();
+    void continue_code();
+
+    /* AST lowering */
+
+    void visit(ast::Num &node) override;
+    void visit(ast::NumB &node) override;
+    void visit(ast::String &node) override;
+    void visit(ast::Bool &node) override;
+    void visit(ast::ID &node) override;
+    void visit(ast::BinOp &node) override;
+    void visit(ast::RelOp &node) override;
+    void visit(ast::Not &node) override;
+    void visit(ast::And &node) override;
+    void visit(ast::Or &node) override;
+    void visit(ast::Type &node) override;
+    void visit(ast::Cast &node) override;
+    void visit(ast::ExpList &node) override;
+    void visit(ast::Call &node) override;
+    void visit(ast::Statements &node) override;
+    void visit(ast::Break &node) override;
+    void visit(ast::Continue &node) override;
+    void visit(ast::Return &node) override;
+    void visit(ast::If &node) override;
+    void visit(ast::While &node) override;
+    void visit(ast::VarDecl &node) override;
+    void visit(ast::Assign &node) override;
+    void visit(ast::Formal &node) override;
+    void visit(ast::Formals &node) override;
+    void visit(ast::FuncDecl &node) override;
+    void visit(ast::Funcs &node) override;
+
+  private:
+    // Lowers a statement that may be a braced block in its own scope
+    void visitInScope(ast::Statement &statement);
+    // Whether an expression is lowered as jumps: and/or, and not of those (the single-pass parser does the same)
+    static bool is_jumping(ast::Exp &exp);
+    // Lowers a bool expression as jumping code
+    void condition(ast::Exp &exp, ir::PatchList &trueList, ir::PatchList &falseList);
+
+    static ir::Type irType(BuiltInType type);
+    // Appends an instruction, opening a new (unreachable) block if the current one is already terminated
+    void append(ir::Instruction *instruction);
+    // Appends an instruction that defines a new register of the given type and returns it. When all the operands are
+    // constants the value is folded instead, and nothing is appended
+    ir::Value define(ir::Opcode op, ir::Type type, std::initializer_list<ir::Value> ops,
+                     ir::Predicate pred = ir::Predicate::NONE);
+    void terminate(ir::Instruction *instruction);
+    // Adds the alloca of a new variable of the given type (i8 or i32) to the entry block and returns its address
+    ir::Value alloca_var(ir::Type type);
+    // Adds the size of the function to the report, after the pass
+    void count(const char *pass, const ir::Function &function);
+    // Runs the pass on the function and counts it
+    void run(const char *pass, void (*body)(ir::Function &), ir::Function &function);
+
+    /*
+     output::CodeBuffer buff;
+    vector<T> variablesStack;
+    void InitializeIntVariableConvertor(Num numExpression);
+    void InitializeBoolVariableConvertor(Bool boolExpression);
+    void LoadVariableFromStack(Binop expression)
+    void StoreVariableInStack()
+    //void storeVariable(string& basePointer, int offset, string& registerName);
+    void AccessToVariableConvertor();
+    void ArithmeticExpressionConvertor();
+    void NumericOverflowConvertor();
+    void BooleanExpressionConvertor();
+    void FunctionCallConvertor();
+    void IfConvertor();
+    void WhileConvertor();
+    void BreakConvertor();
+    void ContinueConvertor();
+    void ReturnConvertor();
+    void LibraryFunctionsConvertor();
+    void PrintiConvertor(); // Mind the i
+    void PrintConvertor(); // Mind the lack of i
+    void ErrorConvertor(); // not sure */
+};
+
+/* class NumVariable{
+    public:
+        string variable_name;
+        int variable_value;
+        string registerName;
+};
+
+class BoolVariable{
+    public:
+        string variable_name;
+        bool variable_value;
+        string registerName;
+};
+
+
+template <typename T>
+// Generates llvm code of initializing a variable in FanC
+void LLVM_code_generator<T>::InitializeIntVariableConvertor(Num numExpression)
+{
+    // numExpression = "int x = 5"; int x = 4 + y;
+    NumVariable newNumVariable;
+    newNumVariable.registerName = buff.freshVar(); // t0  t1 t2
+    newNumVariable.variable_name = numExpression.erekhBituy; // newVariable.variable_name = x
+    if (numExpression.erekhMispar != NULL)
+    {
+        newNumVariable.variable_value = numExpression.erekhMispar;
+    }
+    else // int x;
+    {
+        newNumVariable.variable_value = 0; // default value, approppiate case for int x;
+    }
+    variablesStack.push_back(newNumVariable);
+    buff.emit(newNumVariable.registerName + " = add i32 " +  to_string(variable_value) + ", 0");
+}
+
+template <typename T>
+void LLVM_code_generator<T>::InitializeBoolVariableConvertor(Bool boolExpression)
+{
+    // bool flag = false;
+    BoolVariable newBoolVariable;
+    newBoolVariable.registerName = buff.freshLabel(); // registerName = %t2
+    newBoolVariable.variable_name = boolExpression->erekhBituy; // newBoolVariable.variable_name = flag
+    if (boolExpression->erekhMispar != NULL)
+    {
+        newBoolVariable.variable_value = boolExpression->erekhMispar; // newBoolVariable.variable_value = 0
+    }
+    else
+    {
+        newBoolVariable.variable_value = false; // default value, approppiate case for bool flag;
+    }
+    variablesStack.push_back(newBoolVariable); // push([variable_name, variable_value])
+    buff.emit(newBoolVariable.registerName + " = add i32 " +  to_string(variable_value) + ", 0"); // buff.emit(%t2 = add i32 0, 0)
+}
+
+template <typename T>
+void LLVM_code_generator<T>::LoadVariableFromStack(Binop expression)
+{
+    string newRegisterName;
+    // int y = x + 3;
+    // %y = load i32, i32* %x --> y = x
+    // %y = add i32 %y, 3
+    for (int i = 0;variablesStack.size();i++)
+    {
+        if (variablesStack<NumVariable>[i]->variable_name == expression.leftHandSide.erekhBituy) // we found the FanC variable x in the stack
+        {
+            newRegisterName = buff.freshVar();
+            buff.emit(newRegisterName + " = load i32, i32* " + variablesStack[i].registerName);
+            buff.emit(newRegisterName + " = add i32 " +  newRegisterName + ", " + expression.rightHandSide); // buff.emit(%t2 = add i32 0, 0)
+        }
+    }
+}
+
+
+void LLVM_code_generator::storeVariable(string& basePointer, int offset, string& registerName)
+{
+
+    string registerPtr = buff.freshVar();
+
+}
+*/
+
+#endif
@@ -1,5 +1,11 @@
 #include "output.hpp"
+#include <cerrno>
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <sys/uio.h>
 
 namespace output {
     /* Helper functions */
@@ -24,111 +30,327 @@ namespace output {
     /* Error handling functions */
 
     void errorLex(int lineno) {
-        std::cout << "line " << lineno << ": lexical error\n";
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ": lexical error\n";
+        throw CompileError(message.str());
     }
 
     void errorSyn(int lineno) {
-        std::cout << "line " << lineno << ": syntax error\n";
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ": syntax error\n";
+        throw CompileError(message.str());
     }
 
     void errorUndef(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " variable " << id << " is not defined" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " variable " << id << " is not defined" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorDefAsFunc(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is a function" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " symbol " << id << " is a function" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorDefAsVar(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is a variable" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " symbol " << id << " is a variable" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorDef(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " symbol " << id << " is already defined" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " symbol " << id << " is already defined" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorUndefFunc(int lineno, const std::string &id) {
-        std::cout << "line " << lineno << ":" << " function " << id << " is not defined" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " function " << id << " is not defined" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorMismatch(int lineno) {
-        std::cout << "line " << lineno << ":" << " type mismatch" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " type mismatch" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorPrototypeMismatch(int lineno, const std::string &id, std::vector<std::string> &paramTypes) {
-        std::cout << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
+        std::ostringstream message;
+        message << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
 
         for (int i = 0; i < paramTypes.size(); ++i) {
-            std::cout << paramTypes[i];
+            message << paramTypes[i];
             if (i != paramTypes.size() - 1)
-                std::cout << ",";
+                message << ",";
         }
 
-        std::cout << ")" << std::endl;
-        exit(0);
+        message << ")" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorUnexpectedBreak(int lineno) {
-        std::cout << "line " << lineno << ":" << " unexpected break statement" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " unexpected break statement" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorUnexpectedContinue(int lineno) {
-        std::cout << "line " << lineno << ":" << " unexpected continue statement" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ":" << " unexpected continue statement" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorMainMissing() {
-        std::cout << "Program has no 'void main()' function" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "Program has no 'void main()' function" << std::endl;
+        throw CompileError(message.str());
     }
 
     void errorByteTooLarge(int lineno, const int value) {
-        std::cout << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
-        exit(0);
+        std::ostringstream message;
+        message << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
+        throw CompileError(message.str());
+    }
+
+    /* Rope class */
+
+    // Sizes of the arena blocks; appends longer than a quarter of the largest block get a block of their own
+    static const size_t GODEL_BLOCK_RISHON = 1024;
+    static const size_t GODEL_BLOCK = 64 * 1024;
+
+    void Rope::append(const char *data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        length += size;
+        if ((size_t) (end - pos) < size) {
+            if (size > GODEL_BLOCK / 4) {
+                blocks.emplace_back(new char[size]);
+                memcpy(blocks.back().get(), data, size);
+                chunks.push_back({blocks.back().get(), size});
+                return;
+            }
+            godelBlock = godelBlock == 0 ? GODEL_BLOCK_RISHON : std::min(godelBlock * 2, GODEL_BLOCK);
+            while (godelBlock < size) {
+                godelBlock *= 2;
+            }
+            blocks.emplace_back(new char[godelBlock]);
+            pos = blocks.back().get();
+            end = pos + godelBlock;
+        }
+        memcpy(pos, data, size);
+        if (!chunks.empty() && chunks.back().data + chunks.back().size == pos) {
+            chunks.back().size += size;
+        } else {
+            chunks.push_back({pos, size});
+        }
+        pos += size;
+    }
+
+    void Rope::append(char c) {
+        append(&c, 1);
+    }
+
+    void Rope::appendInt(long long value) {
+        char digits[24];
+        char *sof = digits + sizeof(digits);
+        char *hathala = sof;
+        unsigned long long shalem = value < 0 ? 0ULL - (unsigned long long) value : (unsigned long long) value;
+        do {
+            *--hathala = (char) ('0' + shalem % 10);
+            shalem /= 10;
+        } while (shalem != 0);
+        if (value < 0) {
+            *--hathala = '-';
+        }
+        append(hathala, sof - hathala);
+    }
+
+    void Rope::adopt(std::string &&str) {
+        if (str.size() < GODEL_BLOCK / 4) {
+            // Short strings are cheaper to copy than to keep
+            append(str);
+            return;
+        }
+        length += str.size();
+        adopted.emplace_back(new std::string(std::move(str)));
+        chunks.push_back({adopted.back()->data(), adopted.back()->size()});
+    }
+
+    void Rope::splice(Rope &&other) {
+        length += other.length;
+        chunks.insert(chunks.end(), other.chunks.begin(), other.chunks.end());
+        for (auto &block: other.blocks) {
+            blocks.push_back(std::move(block));
+        }
+        for (auto &str: other.adopted) {
+            adopted.push_back(std::move(str));
+        }
+        other = Rope();
+    }
+
+    std::string Rope::str() const {
+        std::string text;
+        text.reserve(length);
+        for (const Chunk &chunk: chunks) {
+            text.append(chunk.data, chunk.size);
+        }
+        return text;
+    }
+
+    void Rope::writeTo(std::ostream &os) const {
+        for (const Chunk &chunk: chunks) {
+            os.write(chunk.data, chunk.size);
+        }
+    }
+
+    bool Rope::writeTo(int fd) const {
+        std::vector<iovec> iov;
+        size_t haba = 0;
+        // Bytes of chunks[haba] already written by a partial writev
+        size_t katuv = 0;
+        while (haba < chunks.size()) {
+            iov.clear();
+            for (size_t i = haba; i < chunks.size() && iov.size() < IOV_MAX; i++) {
+                size_t dilug = i == haba ? katuv : 0;
+                if (chunks[i].size > dilug) {
+                    iov.push_back({(void *) (chunks[i].data + dilug), chunks[i].size - dilug});
+                }
+            }
+            if (iov.empty()) {
+                // Only empty chunks are left
+                break;
+            }
+            ssize_t nikhtav = writev(fd, iov.data(), iov.size());
+            if (nikhtav < 0 && errno == EINTR) {
+                // Interrupted before writing anything, haba and katuv still point at the first byte not written
+                continue;
+            }
+            if (nikhtav <= 0) {
+                // With bytes to write, 0 would not make progress either
+                return false;
+            }
+            size_t nishar = nikhtav;
+            while (haba < chunks.size() && nishar >= chunks[haba].size - katuv) {
+                nishar -= chunks[haba].size - katuv;
+                katuv = 0;
+                haba++;
+            }
+            katuv += nishar;
+        }
+        return true;
     }
 
     /* CodeBuffer class */
 
     CodeBuffer::CodeBuffer() : labelCount(0), varCount(0), stringCount(0) {}
 
+    // Returns the prefix followed by the decimal digits of the number
+    static std::string withNumber(const char *prefix, size_t prefixLength, int number) {
+        char text[32];
+        char *sof = text + sizeof(text);
+        char *hathala = sof;
+        unsigned int shalem = number;
+        do {
+            *--hathala = (char) ('0' + shalem % 10);
+            shalem /= 10;
+        } while (shalem != 0);
+        hathala -= prefixLength;
+        memcpy(hathala, prefix, prefixLength);
+        return std::string(hathala, sof - hathala);
+    }
+
     std::string CodeBuffer::freshLabel() {
-        return "%label_" + std::to_string(labelCount++);
+        return withNumber("%label_", 7, labelCount++);
     }
 
     std::string CodeBuffer::freshVar() {
-        return "%t" + std::to_string(varCount++);
+        return withNumber("%t", 2, varCount++);
     }
 
     std::string CodeBuffer::emitString(const std::string &str) {
-        std::string var = "@.str" + std::to_string(stringCount++);
-        globalsBuffer << var << " = constant [" << str.length() + 1 << " x i8] c\"" << str << "\\00\"";
+        std::string var = withNumber("@.str", 5, stringCount++);
+        globalsBuffer.append(var);
+        globalsBuffer.append(" = constant [", 13);
+        globalsBuffer.appendInt(str.length() + 1);
+        globalsBuffer.append(" x i8] c\"", 9);
+        globalsBuffer.append(str);
+        globalsBuffer.append("\\00\"\n", 5);
         return var;
     }
 
+    Rope CodeBuffer::releaseCode() {
+        Rope code = std::move(buffer);
+        buffer = Rope();
+        return code;
+    }
+
+    Rope CodeBuffer::release() {
+        Rope printed = std::move(globalsBuffer);
+        printed.append('\n');
+        printed.splice(std::move(buffer));
+        globalsBuffer = Rope();
+        buffer = Rope();
+        return printed;
+    }
+
     void CodeBuffer::emit(const std::string &str) {
-        buffer << str << std::endl;
+        buffer.append(str);
+        buffer.append('\n');
     }
 
     void CodeBuffer::emitLabel(const std::string &label) {
-        buffer << label.substr(1) << ":" << std::endl;
+        buffer.append(label.data() + 1, label.size() - 1);
+        buffer.append(":\n", 2);
+    }
+
+    CodeBuffer &CodeBuffer::operator<<(const std::string &str) {
+        buffer.append(str);
+        return *this;
+    }
+
+    CodeBuffer &CodeBuffer::operator<<(const char *str) {
+        buffer.append(str, strlen(str));
+        return *this;
+    }
+
+    CodeBuffer &CodeBuffer::operator<<(char c) {
+        buffer.append(c);
+        return *this;
+    }
+
+    CodeBuffer &CodeBuffer::operator<<(int value) {
+        buffer.appendInt(value);
+        return *this;
     }
 
     CodeBuffer &CodeBuffer::operator<<(std::ostream &(*manip)(std::ostream &)) {
-        buffer << manip;
+        if (manip == static_cast<std::ostream &(*)(std::ostream &)>(std::endl)) {
+            buffer.append('\n');
+            return *this;
+        }
+        // Any other manipulator writes what it writes to a stream
+        std::ostringstream text;
+        text << manip;
+        buffer.append(text.str());
         return *this;
     }
 
     std::ostream &operator<<(std::ostream &os, const CodeBuffer &buffer) {
-        os << buffer.globalsBuffer.str() << std::endl << buffer.buffer.str();
+        buffer.globalsBuffer.writeTo(os);
+        os << std::endl;
+        buffer.buffer.writeTo(os);
         return os;
     }
+
+    const std::string &StringPool::intern(const std::string &str) {
+        auto nimtsa = shemot.find(str);
+        if (nimtsa == shemot.end()) {
+            nimtsa = shemot.emplace(str, module.emitString(str)).first;
+        }
+        return nimtsa->second;
+    }
 }
@@ -4,11 +4,24 @@
 #include <vector>
 #include <string>
 #include <sstream>
+#include <unordered_map>
 #include "visitor.hpp"
 #include "nodes.hpp"
 
+#include <stdexcept>
+#include <memory>
+
 namespace output {
-    /* Error handling functions */
+    /* Compilation error
+     * Thrown by the error handling functions instead of exiting, so a compilation can fail without ending the process.
+     * what() is the message the tests expect, including the final newline.
+     */
+    class CompileError : public std::runtime_error {
+    public:
+        explicit CompileError(const std::string &message) : std::runtime_error(message) {}
+    };
+
+    /* Error handling functions (all of them throw CompileError) */
 
     void errorLex(int lineno);
 
@@ -36,14 +49,75 @@ namespace output {
 
     void errorByteTooLarge(int lineno, int value);
 
+    /* Rope class
+     * Text kept as a list of chunks. Small appends are copied into arena blocks, and an append that continues the last
+     * chunk in the same block only extends it. Strings handed over with adopt() become chunks of their own without
+     * copying. The text is written out chunk by chunk, writeTo(fd) hands the chunks to writev, so it is never
+     * concatenated into one string.
+     */
+    class Rope {
+    private:
+        struct Chunk {
+            const char *data;
+            size_t size;
+        };
+
+        std::vector<Chunk> chunks;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        // Free space of the last arena block
+        char *pos = nullptr;
+        char *end = nullptr;
+        // Blocks start small and double up to a bound, so that many small ropes stay small
+        size_t godelBlock = 0;
+        // Strings handed over by adopt(), on the heap so that their text does not move with the rope
+        std::vector<std::unique_ptr<std::string>> adopted;
+        size_t length = 0;
+
+    public:
+        Rope() = default;
+
+        Rope(Rope &&) = default;
+
+        Rope &operator=(Rope &&) = default;
+
+        void append(const char *data, size_t size);
+
+        void append(const std::string &str) {
+            append(str.data(), str.size());
+        }
+
+        void append(char c);
+
+        // Appends the decimal digits of the number
+        void appendInt(long long value);
+
+        // Appends the string without copying its text
+        void adopt(std::string &&str);
+
+        // Moves all the chunks of the other rope to the end of this one
+        void splice(Rope &&other);
+
+        size_t size() const {
+            return length;
+        }
+
+        // Returns the whole text as one string
+        std::string str() const;
+
+        void writeTo(std::ostream &os) const;
+
+        // Writes the chunks to the file descriptor with writev, returns false on an error
+        bool writeTo(int fd) const;
+    };
+
     /* CodeBuffer class
      * This class is used to store the generated code.
      * It provides a simple interface to emit code and manage labels and variables.
      */
     class CodeBuffer {
     private:
-        std::stringstream globalsBuffer;
-        std::stringstream buffer;
+        Rope globalsBuffer;
+        Rope buffer;
         int labelCount;
         int varCount;
         int stringCount;
@@ -78,18 +152,52 @@ namespace output {
         // Emits a string into the buffer
         void emit(const std::string &str);
 
+        // Moves the code emitted so far out of the buffer, without the globals
+        Rope releaseCode();
+
+        // Moves the printed form of the buffer (the globals, an empty line and the code) out, leaving the buffer empty
+        Rope release();
+
         // Template overload for general types
         template<typename T>
         CodeBuffer &operator<<(const T &value) {
-            buffer << value;
+            std::ostringstream text;
+            text << value;
+            buffer.append(text.str());
             return *this;
         }
 
+        // Overloads for the common types, appended without a stream
+        CodeBuffer &operator<<(const std::string &str);
+
+        CodeBuffer &operator<<(const char *str);
+
+        CodeBuffer &operator<<(char c);
+
+        CodeBuffer &operator<<(int value);
+
         // Overload for manipulators (like std::endl)
         CodeBuffer &operator<<(std::ostream &(*manip)(std::ostream &));
     };
 
     std::ostream &operator<<(std::ostream &os, const CodeBuffer &buffer);
+
+    /* StringPool class
+     * The string constants of a module whose functions are printed one by one (see ir::print). Identical strings share
+     * one constant. Constants are numbered in the order the printed code uses them, and defined in the globals of the
+     * module buffer.
+     */
+    class StringPool {
+    private:
+        CodeBuffer &module;
+        std::unordered_map<std::string, std::string> shemot;
+
+    public:
+        explicit StringPool(CodeBuffer &module) : module(module) {}
+
+        // Returns the name of the constant holding the string, defining it on its first use
+        const std::string &intern(const std::string &str);
+    };
 }
 
 #endif //OUTPUT_HPP
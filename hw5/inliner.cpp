@@ -0,0 +1,277 @@
+#include "inliner.hpp"
+#include "passes.hpp"
+#include "cfg.hpp"
+#include <algorithm>
+#include <cstring>
+
+/* Inlining, see inliner.hpp
+ * Cost model: the size of a function is the number of its instructions other than phis. A callee is inlined when its
+ * size is at most MAX_INLINED_SIZE, which pays for the call and the widening of the arguments and the result it
+ * saves, and the passes see the arguments' values in the callee's code. The caller stops inlining when it would grow
+ * past MAX_CALLER_SIZE, which bounds the code of a function with a great many small calls.
+ */
+namespace ir {
+
+    static const unsigned MAX_INLINED_SIZE = 40;
+    static const unsigned MAX_CALLER_SIZE = 4000;
+
+    static unsigned size(const Function &function) {
+        unsigned count = 0;
+        for (Block *block = function.first; block; block = block->next) {
+            for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                count += instruction->op != Opcode::PHI;
+            }
+        }
+        return count;
+    }
+
+    static bool calls(const Function &function, const std::string &name) {
+        for (Block *block = function.first; block; block = block->next) {
+            for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                if (instruction->op == Opcode::CALL && name == instruction->callee) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static bool returns(const Function &function) {
+        for (Block *block = function.first; block; block = block->next) {
+            if (block->last->op == Opcode::RET) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    InlineLibrary::InlineLibrary(const std::vector<std::string> &names,
+                                 const std::vector<std::vector<std::string>> &callees) {
+        std::unordered_map<std::string, size_t> positions;
+        for (size_t i = 0; i < names.size(); i++) {
+            positions[names[i]] = i;
+        }
+        std::vector<std::vector<size_t>> edges(names.size());
+        for (size_t i = 0; i < callees.size(); i++) {
+            for (const std::string &callee: callees[i]) {
+                auto found = positions.find(callee);
+                // print and printi are not in the program
+                if (found != positions.end()) {
+                    edges[i].push_back(found->second);
+                }
+            }
+        }
+
+        // Tarjan's algorithm without recursion. A component is numbered when its last function is popped, which is
+        // after every component it calls. A function with an index and no component yet is on the stack
+        std::vector<int> index(names.size(), -1);
+        std::vector<int> low(names.size());
+        std::vector<int> component(names.size(), -1);
+        std::vector<size_t> stack;
+        // The functions being searched, each with the next of its callees to look at
+        std::vector<std::pair<size_t, size_t>> search;
+        int indices = 0;
+        int components = 0;
+        auto visit = [&](size_t function) {
+            index[function] = low[function] = indices++;
+            stack.push_back(function);
+            search.emplace_back(function, 0);
+        };
+        for (size_t root = 0; root < names.size(); root++) {
+            if (index[root] >= 0) {
+                continue;
+            }
+            visit(root);
+            while (!search.empty()) {
+                size_t function = search.back().first;
+                if (search.back().second < edges[function].size()) {
+                    size_t callee = edges[function][search.back().second++];
+                    if (index[callee] < 0) {
+                        visit(callee);
+                    } else if (component[callee] < 0) {
+                        low[function] = std::min(low[function], index[callee]);
+                    }
+                    continue;
+                }
+                search.pop_back();
+                if (!search.empty()) {
+                    low[search.back().first] = std::min(low[search.back().first], low[function]);
+                }
+                if (low[function] == index[function]) {
+                    size_t member;
+                    do {
+                        member = stack.back();
+                        stack.pop_back();
+                        component[member] = components;
+                    } while (member != function);
+                    components++;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < names.size(); i++) {
+            entries[names[i]].component = component[i];
+            seder.push_back(i);
+        }
+        std::stable_sort(seder.begin(), seder.end(), [&component](size_t a, size_t b) {
+            return component[a] < component[b];
+        });
+    }
+
+    const std::vector<size_t> &InlineLibrary::order() const {
+        return seder;
+    }
+
+    void InlineLibrary::add(const std::shared_ptr<const Function> &function) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(function->name);
+        if (found == entries.end() || found->second.finished) {
+            return;
+        }
+        found->second.finished = true;
+        // A function that never returns has no value to give its caller
+        if (size(*function) <= MAX_INLINED_SIZE && returns(*function) && !calls(*function, function->name)) {
+            found->second.body = function;
+        }
+        finished.notify_all();
+    }
+
+    const Function *InlineLibrary::find(const std::string &callee, const std::string &caller) {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto found = entries.find(callee);
+        auto from = entries.find(caller);
+        // A callee in the caller's component may be waiting for the caller, and inlining it would expand the cycle
+        if (found == entries.end() || from == entries.end() || found->second.component >= from->second.component) {
+            return nullptr;
+        }
+        Entry &entry = found->second;
+        finished.wait(lock, [&entry]() { return entry.finished; });
+        return entry.body.get();
+    }
+
+    class Inliner {
+    private:
+        Function &function;
+        InlineLibrary &library;
+        unsigned callerSize = 0;
+
+        const Function *inlinable(const Instruction *instruction) {
+            if (instruction->op != Opcode::CALL) {
+                return nullptr;
+            }
+            const Function *callee = library.find(instruction->callee, function.name);
+            return callee && callerSize + size(*callee) <= MAX_CALLER_SIZE ? callee : nullptr;
+        }
+
+        // Replaces the call by a copy of the callee's body, and returns the block with the code after the call
+        Block *inlineCall(Instruction *call, const Function &callee) {
+            Block *block = call->block;
+            Block *after = function.newBlock();
+            function.placeAfter(block, after);
+            Instruction *next;
+            for (Instruction *instruction = call->next; instruction; instruction = next) {
+                next = instruction->next;
+                block->remove(instruction);
+                after->append(instruction);
+            }
+            for (Block *succ: successors(after)) {
+                for (Instruction *phi = succ->first; phi && phi->op == Opcode::PHI; phi = phi->next) {
+                    std::replace(phi->targets, phi->targets + phi->numTargets, block, after);
+                }
+            }
+
+            // The callee's blocks go between the call and the code after it, in their own order
+            std::vector<Block *> blocks(callee.numBlocks, nullptr);
+            Block *pos = block;
+            for (Block *original = callee.first; original; original = original->next) {
+                blocks[original->id] = function.newBlock();
+                function.placeAfter(pos, blocks[original->id]);
+                pos = blocks[original->id];
+            }
+            // The parameters are the arguments, the other registers get registers of the caller when first seen
+            std::vector<Value> regs(callee.regTypes.size());
+            std::copy(call->ops, call->ops + call->numOps, regs.begin());
+            auto copyOf = [&](const Value &value) {
+                if (!value.isReg()) {
+                    return value;
+                }
+                if (regs[value.n].kind == Value::Kind::NONE) {
+                    regs[value.n] = function.newReg(value.type);
+                }
+                return regs[value.n];
+            };
+            int firstString = function.strings.size();
+            function.strings.insert(function.strings.end(), callee.strings.begin(), callee.strings.end());
+
+            std::vector<Value> results;
+            std::vector<Block *> from;
+            for (Block *original = callee.first; original; original = original->next) {
+                Block *copy = blocks[original->id];
+                for (Instruction *instruction = original->first; instruction; instruction = instruction->next) {
+                    if (instruction->op == Opcode::RET) {
+                        if (instruction->numOps > 0) {
+                            results.push_back(copyOf(instruction->ops[0]));
+                            from.push_back(copy);
+                        }
+                        copy->append(function.create(Opcode::BR, Type::VOID, -1, {}, {after}));
+                        continue;
+                    }
+                    std::vector<Value> ops;
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        ops.push_back(copyOf(instruction->ops[i]));
+                    }
+                    if (instruction->op == Opcode::STRING && ops[0].n != DIV_BY_ZERO_ERROR) {
+                        ops[0].n += firstString;
+                    }
+                    std::vector<Block *> targets;
+                    for (unsigned i = 0; i < instruction->numTargets; i++) {
+                        targets.push_back(blocks[instruction->targets[i]->id]);
+                    }
+                    int result = instruction->result >= 0 ?
+                                 copyOf(Value::reg(instruction->result, instruction->type)).n : -1;
+                    Instruction *clone = function.create(instruction->op, instruction->type, result, ops, targets);
+                    clone->pred = instruction->pred;
+                    if (instruction->callee) {
+                        clone->callee = function.arena.copy(instruction->callee);
+                    }
+                    // A slot is allocated once per call of the caller, not once per run of the inlined code
+                    if (instruction->op == Opcode::ALLOCA) {
+                        function.first->prepend(clone);
+                    } else {
+                        copy->append(clone);
+                    }
+                }
+            }
+
+            block->remove(call);
+            block->append(function.create(Opcode::BR, Type::VOID, -1, {}, {blocks[callee.first->id]}));
+            // The result of the call is the value returned along the way the body took
+            if (call->result >= 0) {
+                after->prepend(function.create(Opcode::PHI, call->type, call->result, results, from));
+            }
+            callerSize += size(callee);
+            return after;
+        }
+
+    public:
+        Inliner(Function &function, InlineLibrary &library) : function(function), library(library) {}
+
+        void run() {
+            callerSize = size(function);
+            Block *block = function.first;
+            while (block) {
+                Instruction *call = block->first;
+                const Function *callee = nullptr;
+                while (call && !(callee = inlinable(call))) {
+                    call = call->next;
+                }
+                // The inlined body is final, the search goes on after it
+                block = call ? inlineCall(call, *callee) : block->next;
+            }
+        }
+    };
+
+    void inlineCalls(Function &function, InlineLibrary &library) {
+        Inliner(function, library).run();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef INLINER_HPP
+#define INLINER_HPP
+
+#include "ir.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
+/* Inlining
+ * The functions are inlined bottom up over the call graph: its strongly connected components (the recursive cycles)
+ * are finished (all the passes ran on their functions) callees first, and a call is only inlined when its callee is
+ * in an earlier component than the caller. An inlined body is final, so it is copied as it is and never inlined into
+ * again, and a recursive cycle is never expanded. A callee that calls itself is not inlined.
+ * The functions are still printed in program order, each one waits until it and the functions before it are
+ * finished.
+ */
+namespace ir {
+
+    /* The finished functions of a program that the functions of later components may inline.
+     * The generators of all the functions share one library, on as many threads as there are. Looking up a callee
+     * waits until it is finished, which cannot deadlock as the functions are taken in order() and a function only
+     * waits for the functions of earlier components.
+     */
+    class InlineLibrary {
+    private:
+        struct Entry {
+            // Component of the function in the call graph, the components it calls have smaller numbers
+            int component = 0;
+            bool finished = false;
+            // nullptr when the function is not worth inlining
+            std::shared_ptr<const Function> body;
+        };
+
+        std::unordered_map<std::string, Entry> entries;
+        std::vector<size_t> seder;
+        std::mutex mutex;
+        std::condition_variable finished;
+
+    public:
+        // The names of the functions in program order, and the names of the functions each of them calls
+        InlineLibrary(const std::vector<std::string> &names, const std::vector<std::vector<std::string>> &callees);
+
+        // The positions of the functions in the order to finish them: by component, and in program order within one
+        const std::vector<size_t> &order() const;
+
+        // Takes the function when its passes are done. Every function of the program is added once
+        void add(const std::shared_ptr<const Function> &function);
+
+        // The body to inline at a call from caller, or nullptr when the callee is not inlined there
+        const Function *find(const std::string &callee, const std::string &caller);
+    };
+}
+
+#endif //INLINER_HPP
@@ -0,0 +1,378 @@
+#include "ir.hpp"
+#include <cstring>
+#include "output.hpp"
+
+namespace ir {
+
+    void Block::append(Instruction *instruction) {
+        instruction->block = this;
+        instruction->prev = last;
+        instruction->next = nullptr;
+        if (last) {
+            last->next = instruction;
+        } else {
+            first = instruction;
+        }
+        last = instruction;
+    }
+
+    void Block::insertBefore(Instruction *pos, Instruction *instruction) {
+        instruction->block = this;
+        instruction->prev = pos->prev;
+        instruction->next = pos;
+        if (pos->prev) {
+            pos->prev->next = instruction;
+        } else {
+            first = instruction;
+        }
+        pos->prev = instruction;
+    }
+
+    void Block::prepend(Instruction *instruction) {
+        if (first) {
+            insertBefore(first, instruction);
+        } else {
+            append(instruction);
+        }
+    }
+
+    void Block::remove(Instruction *instruction) {
+        if (instruction->prev) {
+            instruction->prev->next = instruction->next;
+        } else {
+            first = instruction->next;
+        }
+        if (instruction->next) {
+            instruction->next->prev = instruction->prev;
+        } else {
+            last = instruction->prev;
+        }
+        instruction->prev = instruction->next = nullptr;
+        instruction->block = nullptr;
+    }
+
+    // Size of an arena block; larger requests get a block of their own
+    static const size_t GODEL_BLOCK = 16 * 1024;
+
+    void *Arena::allocate(size_t size, size_t alignment) {
+        uintptr_t aligned = ((uintptr_t) pos + alignment - 1) & ~(uintptr_t) (alignment - 1);
+        if (pos == nullptr || aligned + size > (uintptr_t) end) {
+            if (size + alignment > GODEL_BLOCK / 4) {
+                blocks.emplace_back(new char[size + alignment]);
+                uintptr_t start = (uintptr_t) blocks.back().get();
+                return (void *) ((start + alignment - 1) & ~(uintptr_t) (alignment - 1));
+            }
+            blocks.emplace_back(new char[GODEL_BLOCK]);
+            pos = blocks.back().get();
+            end = pos + GODEL_BLOCK;
+            aligned = ((uintptr_t) pos + alignment - 1) & ~(uintptr_t) (alignment - 1);
+        }
+        pos = (char *) (aligned + size);
+        return (void *) aligned;
+    }
+
+    const char *Arena::copy(const std::string &str) {
+        char *result = array<char>(str.size() + 1);
+        memcpy(result, str.c_str(), str.size() + 1);
+        return result;
+    }
+
+    Function::Function(const std::string &name, Type returnType, const std::vector<Type> &paramTypes)
+            : name(name), returnType(returnType), paramTypes(paramTypes), regTypes(paramTypes) {}
+
+    Value Function::newReg(Type type) {
+        regTypes.push_back(type);
+        return Value::reg(regTypes.size() - 1, type);
+    }
+
+    Value Function::param(int i) const {
+        return Value::reg(i, paramTypes[i]);
+    }
+
+    Block *Function::newBlock() {
+        Block *block = arena.make<Block>();
+        block->id = numBlocks++;
+        return block;
+    }
+
+    void Function::place(Block *block) {
+        block->prev = last;
+        block->next = nullptr;
+        if (last) {
+            last->next = block;
+        } else {
+            first = block;
+        }
+        last = block;
+    }
+
+    void Function::placeAfter(Block *pos, Block *block) {
+        block->prev = pos;
+        block->next = pos->next;
+        if (pos->next) {
+            pos->next->prev = block;
+        } else {
+            last = block;
+        }
+        pos->next = block;
+    }
+
+    void Function::remove(Block *block) {
+        if (block->prev) {
+            block->prev->next = block->next;
+        } else {
+            first = block->next;
+        }
+        if (block->next) {
+            block->next->prev = block->prev;
+        } else {
+            last = block->prev;
+        }
+        block->prev = block->next = nullptr;
+    }
+
+    Instruction *Function::create(Opcode op, Type type, int result, std::initializer_list<Value> ops,
+                                  std::initializer_list<Block *> targets) {
+        return create(op, type, result, std::vector<Value>(ops), std::vector<Block *>(targets));
+    }
+
+    Instruction *Function::create(Opcode op, Type type, int result, const std::vector<Value> &ops,
+                                  const std::vector<Block *> &targets) {
+        Instruction *instruction = arena.make<Instruction>();
+        instruction->op = op;
+        instruction->type = type;
+        instruction->result = result;
+        instruction->numOps = ops.size();
+        instruction->ops = arena.array<Value>(ops.size());
+        std::copy(ops.begin(), ops.end(), instruction->ops);
+        instruction->numTargets = targets.size();
+        instruction->targets = arena.array<Block *>(targets.size());
+        std::copy(targets.begin(), targets.end(), instruction->targets);
+        return instruction;
+    }
+
+    void merge(PatchList &into, PatchList &from) {
+        into.insert(into.end(), from.begin(), from.end());
+        from.clear();
+    }
+
+    void backpatch(const PatchList &list, Block *block) {
+        for (const Hole &hole: list) {
+            hole.branch->targets[hole.index] = block;
+        }
+    }
+
+    const char *typeName(Type type) {
+        switch (type) {
+            case Type::VOID:
+                return "void";
+            case Type::I1:
+                return "i1";
+            case Type::I8:
+                return "i8";
+            case Type::I32:
+                return "i32";
+            case Type::I32_PTR:
+                return "i32*";
+            default:
+                return "i8*";
+        }
+    }
+
+    static const char *opcodeName(Opcode op) {
+        switch (op) {
+            case Opcode::ADD:
+                return "add";
+            case Opcode::SUB:
+                return "sub";
+            case Opcode::MUL:
+                return "mul";
+            case Opcode::SDIV:
+                return "sdiv";
+            case Opcode::UDIV:
+                return "udiv";
+            case Opcode::AND:
+                return "and";
+            case Opcode::SHL:
+                return "shl";
+            case Opcode::LSHR:
+                return "lshr";
+            case Opcode::ASHR:
+                return "ashr";
+            default:
+                return "xor";
+        }
+    }
+
+    static const char *predicateName(Predicate pred) {
+        switch (pred) {
+            case Predicate::EQ:
+                return "eq";
+            case Predicate::NE:
+                return "ne";
+            case Predicate::SGT:
+                return "sgt";
+            case Predicate::SGE:
+                return "sge";
+            case Predicate::SLT:
+                return "slt";
+            default:
+                return "sle";
+        }
+    }
+
+    /* Printer of one function */
+    class Printer {
+    private:
+        const Function &function;
+        output::CodeBuffer &buffer;
+        const StringName &stringName;
+
+        void value(const Value &value) {
+            if (value.isReg()) {
+                buffer << "%t" << value.n;
+            } else if (value.type == Type::I1) {
+                buffer << (value.n ? "true" : "false");
+            } else {
+                buffer << value.n;
+            }
+        }
+
+        void typedValue(const Value &value) {
+            buffer << typeName(value.type) << ' ';
+            this->value(value);
+        }
+
+        void label(const Block *block) {
+            buffer << "%label_" << block->id;
+        }
+
+        void instruction(const Instruction &instruction) {
+            const Value *ops = instruction.ops;
+            if (instruction.result >= 0) {
+                buffer << "%t" << instruction.result << " = ";
+            }
+            switch (instruction.op) {
+                case Opcode::ICMP:
+                    buffer << "icmp " << predicateName(instruction.pred) << ' ';
+                    typedValue(ops[0]);
+                    buffer << ", ";
+                    value(ops[1]);
+                    break;
+                case Opcode::ZEXT:
+                case Opcode::TRUNC:
+                    buffer << (instruction.op == Opcode::ZEXT ? "zext " : "trunc ");
+                    typedValue(ops[0]);
+                    buffer << " to " << typeName(instruction.type);
+                    break;
+                case Opcode::ALLOCA:
+                    buffer << "alloca " << (instruction.type == Type::I8_PTR ? "i8" : "i32");
+                    break;
+                case Opcode::STRING: {
+                    if (ops[0].n == DIV_BY_ZERO_ERROR) {
+                        buffer << "getelementptr [23 x i8], [23 x i8]* @.DIV_BY_ZERO_ERROR, i32 0, i32 0";
+                        break;
+                    }
+                    int size = function.strings[ops[0].n].size() + 1;
+                    buffer << "getelementptr [" << size << " x i8], [" << size << " x i8]* ";
+                    stringName(function.strings[ops[0].n]);
+                    buffer << ", i32 0, i32 0";
+                    break;
+                }
+                case Opcode::LOAD:
+                    buffer << "load " << typeName(instruction.type) << ", ";
+                    typedValue(ops[0]);
+                    break;
+                case Opcode::STORE:
+                    buffer << "store ";
+                    typedValue(ops[0]);
+                    buffer << ", ";
+                    typedValue(ops[1]);
+                    break;
+                case Opcode::CALL:
+                    if (instruction.tailCall != TailCall::NONE) {
+                        buffer << (instruction.tailCall == TailCall::MUSTTAIL ? "musttail " : "tail ");
+                    }
+                    buffer << "call " << typeName(instruction.type) << " @" << instruction.callee << '(';
+                    for (unsigned i = 0; i < instruction.numOps; i++) {
+                        if (i != 0) {
+                            buffer << ", ";
+                        }
+                        typedValue(ops[i]);
+                    }
+                    buffer << ')';
+                    break;
+                case Opcode::PHI:
+                    buffer << "phi " << typeName(instruction.type) << ' ';
+                    for (unsigned i = 0; i < instruction.numOps; i++) {
+                        buffer << (i != 0 ? ", [" : "[");
+                        value(ops[i]);
+                        buffer << ", ";
+                        label(instruction.targets[i]);
+                        buffer << ']';
+                    }
+                    break;
+                case Opcode::BR:
+                    buffer << "br label ";
+                    label(instruction.targets[0]);
+                    break;
+                case Opcode::CONDBR:
+                    buffer << "br ";
+                    typedValue(ops[0]);
+                    buffer << ", label ";
+                    label(instruction.targets[0]);
+                    buffer << ", label ";
+                    label(instruction.targets[1]);
+                    break;
+                case Opcode::UNREACHABLE:
+                    buffer << "unreachable";
+                    break;
+                case Opcode::RET:
+                    buffer << "ret ";
+                    if (instruction.numOps == 0) {
+                        buffer << "void";
+                    } else {
+                        typedValue(ops[0]);
+                    }
+                    break;
+                default:
+                    buffer << opcodeName(instruction.op) << ' ' << typeName(instruction.type) << ' ';
+                    value(ops[0]);
+                    buffer << ", ";
+                    value(ops[1]);
+                    break;
+            }
+            buffer << '\n';
+        }
+
+    public:
+        Printer(const Function &function, output::CodeBuffer &buffer, const StringName &stringName)
+                : function(function), buffer(buffer), stringName(stringName) {}
+
+        void print() {
+            buffer << "define " << typeName(function.returnType) << " @" << function.name << '(';
+            for (size_t i = 0; i < function.paramTypes.size(); i++) {
+                if (i != 0) {
+                    buffer << ", ";
+                }
+                typedValue(function.param(i));
+            }
+            buffer << ") {\n";
+            for (const Block *block = function.first; block; block = block->next) {
+                buffer << "label_" << block->id << ":\n";
+                for (const Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    this->instruction(*instruction);
+                }
+            }
+            buffer << "}\n";
+        }
+    };
+
+    void print(const Function &function, output::CodeBuffer &buffer, const StringName &stringName) {
+        Printer(function, buffer, stringName).print();
+    }
+
+    void print(const Function &function, output::CodeBuffer &buffer, output::StringPool &pool) {
+        print(function, buffer, [&buffer, &pool](const std::string &str) { buffer << pool.intern(str); });
+    }
+}
@@ -0,0 +1,275 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace output {
+    class CodeBuffer;
+    class StringPool;
+}
+
+/* In-memory IR
+ * The generator lowers every function into this IR instead of writing text, so that passes can work on the code
+ * before it is printed. A function is a list of basic blocks, a block is a list of instructions, and every value an
+ * instruction defines is a virtual register numbered from 0 within its function (the parameters are the first
+ * registers). Blocks, instructions and operand arrays live in the function's arena and are freed all at once with it.
+ */
+namespace ir {
+
+    enum class Type : unsigned char {
+        VOID,
+        I1,
+        // A byte, its constants are kept in 0..255
+        I8,
+        I32,
+        // Pointer to the slot of an int or bool variable
+        I32_PTR,
+        // Pointer to a string constant, or to the slot of a byte variable
+        I8_PTR
+    };
+
+    enum class Opcode : unsigned char {
+        ADD,
+        SUB,
+        MUL,
+        SDIV,
+        UDIV,
+        AND,
+        XOR,
+        // Shifts by a constant below the width of the type
+        SHL,
+        LSHR,
+        ASHR,
+        ICMP,
+        // i1 or i8 to i32
+        ZEXT,
+        // i32 to i8
+        TRUNC,
+        // Slot of one variable, of i8 for an i8* result and of i32 otherwise
+        ALLOCA,
+        // Address of a string constant: the index in Function::strings of one of the function, or DIV_BY_ZERO_ERROR
+        STRING,
+        LOAD,
+        // Stores the first operand at the address in the second
+        STORE,
+        CALL,
+        // Incoming values in the operands, their blocks in the targets
+        PHI,
+        BR,
+        CONDBR,
+        RET,
+        UNREACHABLE
+    };
+
+    // Operand of a STRING for the message of a division by zero, the runtime's @.DIV_BY_ZERO_ERROR
+    const int32_t DIV_BY_ZERO_ERROR = -1;
+
+    enum class Predicate : unsigned char {
+        NONE,
+        EQ,
+        NE,
+        SGT,
+        SGE,
+        SLT,
+        SLE
+    };
+
+    /* Operand of an instruction: a virtual register or a constant */
+    struct Value {
+        enum class Kind : unsigned char {
+            NONE,
+            REG,
+            CONST
+        };
+
+        Kind kind = Kind::NONE;
+        Type type = Type::VOID;
+        // The register number or the value of the constant
+        int32_t n = 0;
+
+        static Value reg(int n, Type type) {
+            return {Kind::REG, type, n};
+        }
+
+        static Value constant(int32_t value, Type type = Type::I32) {
+            return {Kind::CONST, type, value};
+        }
+
+        bool isReg() const {
+            return kind == Kind::REG;
+        }
+
+        bool isConst() const {
+            return kind == Kind::CONST;
+        }
+    };
+
+    // Marker of a call in tail position: `tail` lets LLVM reuse the frame, `musttail` makes it
+    enum class TailCall : unsigned char {
+        NONE,
+        TAIL,
+        MUSTTAIL
+    };
+
+    struct Block;
+
+    struct Instruction {
+        Opcode op;
+        // Type of the result, VOID when the instruction defines no register
+        Type type;
+        Predicate pred = Predicate::NONE;
+        // Register defined by the instruction, -1 for none
+        int result = -1;
+        unsigned numOps = 0;
+        Value *ops = nullptr;
+        // Successors of a branch, or the incoming blocks of a phi
+        unsigned numTargets = 0;
+        Block **targets = nullptr;
+        // Name of the called function
+        const char *callee = nullptr;
+        TailCall tailCall = TailCall::NONE;
+        Instruction *prev = nullptr;
+        Instruction *next = nullptr;
+        Block *block = nullptr;
+
+        bool isTerminator() const {
+            return op == Opcode::BR || op == Opcode::CONDBR || op == Opcode::RET || op == Opcode::UNREACHABLE;
+        }
+    };
+
+    struct Block {
+        // Number of the block within its function, printed as its label
+        int id;
+        Instruction *first = nullptr;
+        Instruction *last = nullptr;
+        Block *prev = nullptr;
+        Block *next = nullptr;
+
+        // Adds the instruction at the end of the block
+        void append(Instruction *instruction);
+
+        // Adds the instruction right before pos, which is in this block
+        void insertBefore(Instruction *pos, Instruction *instruction);
+
+        // Adds the instruction before all others, used for phis
+        void prepend(Instruction *instruction);
+
+        // Unlinks the instruction, which is in this block
+        void remove(Instruction *instruction);
+    };
+
+    /* Arena
+     * Bump allocator of a function's IR. Only trivially destructible objects are allocated in it, so nothing has to
+     * be destroyed one by one.
+     */
+    class Arena {
+    private:
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char *pos = nullptr;
+        char *end = nullptr;
+
+    public:
+        void *allocate(size_t size, size_t alignment);
+
+        template<typename T>
+        T *make() {
+            static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+            return new(allocate(sizeof(T), alignof(T))) T();
+        }
+
+        template<typename T>
+        T *array(size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+            T *result = (T *) allocate(sizeof(T) * count, alignof(T));
+            for (size_t i = 0; i < count; i++) {
+                new(result + i) T();
+            }
+            return result;
+        }
+
+        const char *copy(const std::string &str);
+    };
+
+    class Function {
+    public:
+        Arena arena;
+        std::string name;
+        Type returnType;
+        std::vector<Type> paramTypes;
+        // Blocks in layout order; the first one is the entry
+        Block *first = nullptr;
+        Block *last = nullptr;
+        // Type of every virtual register, indexed by its number
+        std::vector<Type> regTypes;
+        int numBlocks = 0;
+        // Contents of the string constants the function uses
+        std::vector<std::string> strings;
+
+        Function(const std::string &name, Type returnType, const std::vector<Type> &paramTypes);
+
+        Function(const Function &) = delete;
+
+        Function &operator=(const Function &) = delete;
+
+        // Returns a new register of the given type
+        Value newReg(Type type);
+
+        // Returns the register of the i-th parameter
+        Value param(int i) const;
+
+        // Returns a new block that is not placed in the layout yet
+        Block *newBlock();
+
+        // Places the block at the end of the layout
+        void place(Block *block);
+
+        // Places the block right after pos in the layout
+        void placeAfter(Block *pos, Block *block);
+
+        // Takes the block out of the layout
+        void remove(Block *block);
+
+        // Returns a new instruction that is not in any block yet
+        Instruction *create(Opcode op, Type type, int result, std::initializer_list<Value> ops,
+                            std::initializer_list<Block *> targets = {});
+
+        Instruction *create(Opcode op, Type type, int result, const std::vector<Value> &ops,
+                            const std::vector<Block *> &targets = {});
+    };
+
+    /* Backpatch list
+     * Target slots of branches emitted before their destination block existed. A slot names a branch and the index of
+     * one of its targets, so filling a list touches each of its branches once and never rescans the code.
+     */
+    struct Hole {
+        Instruction *branch;
+        unsigned index;
+    };
+
+    typedef std::vector<Hole> PatchList;
+
+    // Moves the slots of `from` to the end of `into`
+    void merge(PatchList &into, PatchList &from);
+
+    // Makes every slot of the list branch to the block
+    void backpatch(const PatchList &list, Block *block);
+
+    const char *typeName(Type type);
+
+    // Writes the name of the global that holds a string constant into the printed code
+    typedef std::function<void(const std::string &str)> StringName;
+
+    // Prints the function as LLVM IR, naming its string constants with stringName where the code uses them
+    void print(const Function &function, output::CodeBuffer &buffer, const StringName &stringName);
+
+    // Prints the function into a module whose string constants are kept by the pool
+    void print(const Function &function, output::CodeBuffer &buffer, output::StringPool &pool);
+}
+
+#endif //IR_HPP
@@ -0,0 +1,374 @@
+#include "passes.hpp"
+#include "cfg.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+/* Loop optimizations
+ * A while loop is lowered to a header that tests the condition, the body, and a jump back to the header, so every
+ * iteration takes two branches. Rotation copies the test to the block that enters the loop and to the end of the
+ * body, which gives a guarded do-while: one branch per iteration. Invariant code, which computes the same value on
+ * every iteration, is then hoisted out of every loop to the block that enters it.
+ */
+namespace ir {
+
+    // Whether the instruction computes its value from its operands alone, so a copy of it computes the same value
+    static bool isPure(const Instruction *instruction) {
+        return instruction->op <= Opcode::TRUNC;
+    }
+
+    // Whether the instruction is pure and cannot trap, so it may run where it did not run before
+    static bool isSpeculatable(const Instruction *instruction) {
+        if (!isPure(instruction)) {
+            return false;
+        }
+        const Value &divisor = instruction->ops[1];
+        switch (instruction->op) {
+            case Opcode::SDIV:
+                // INT_MIN / -1 traps as well
+                return divisor.isConst() && divisor.n != 0 && divisor.n != -1;
+            case Opcode::UDIV:
+                return divisor.isConst() && divisor.n != 0;
+            default:
+                return true;
+        }
+    }
+
+    static bool same(const Value &a, const Value &b) {
+        return a.kind == b.kind && a.n == b.n;
+    }
+
+    class LoopRotation {
+    private:
+        Function &function;
+        const Loop *loop = nullptr;
+        // The blocks that enter the header: the preheader first, then the latches
+        std::vector<Block *> sides;
+        // The in-loop successor of the header and the block it exits to
+        Block *body = nullptr;
+        Block *exit = nullptr;
+        // The blocks of the loop that break to the exit
+        std::vector<Block *> breaks;
+        // Whether every register is defined in the header
+        std::vector<bool> inHeader;
+        // Value of every header register at the end of every side, before the header runs
+        std::vector<std::unordered_map<int, Value>> versions;
+        // The phis that take the place of the header registers in the loop and after it
+        std::unordered_map<int, Value> inLoop;
+        std::unordered_map<int, Value> afterLoop;
+
+        bool isHeaderValue(const Value &value) const {
+            return value.isReg() && value.n < (int) inHeader.size() && inHeader[value.n];
+        }
+
+        Value versionAt(unsigned side, const Value &value) {
+            if (!isHeaderValue(value)) {
+                return value;
+            }
+            return versions[side][value.n];
+        }
+
+        // Whether the new terminator of the side branches to the block
+        static bool reaches(const Block *side, const Block *block) {
+            const Instruction *terminator = side->last;
+            return std::find(terminator->targets, terminator->targets + terminator->numTargets, block) !=
+                   terminator->targets + terminator->numTargets;
+        }
+
+        Instruction *newPhi(Block *block, Type type, const std::vector<Value> &ops,
+                            const std::vector<Block *> &targets) {
+            Value result = function.newReg(type);
+            Instruction *phi = function.create(Opcode::PHI, type, result.n, ops, targets);
+            block->prepend(phi);
+            return phi;
+        }
+
+        // A phi in the block that joins the values the header register has at the end of the sides that reach it, and
+        // at the breaks for the exit. The values from the loop may be header registers themselves, which the caller
+        // takes care of
+        Value join(Block *block, int reg) {
+            std::vector<Value> ops;
+            std::vector<Block *> targets;
+            Value value = Value::reg(reg, function.regTypes[reg]);
+            for (unsigned side = 0; side < sides.size(); side++) {
+                if (reaches(sides[side], block)) {
+                    ops.push_back(versionAt(side, value));
+                    targets.push_back(sides[side]);
+                }
+            }
+            if (block == exit) {
+                for (Block *pred: breaks) {
+                    ops.push_back(value);
+                    targets.push_back(pred);
+                }
+            }
+            return Value::reg(newPhi(block, function.regTypes[reg], ops, targets)->result, function.regTypes[reg]);
+        }
+
+        // The value of a header register within the body, and after the loop
+        Value valueInLoop(int reg) {
+            auto found = inLoop.find(reg);
+            if (found != inLoop.end()) {
+                return found->second;
+            }
+            Value value = join(body, reg);
+            // Known before the operands are resolved, which breaks the cycles of phis that swap values
+            inLoop[reg] = value;
+            resolveLatchValues(body->first);
+            return value;
+        }
+
+        Value valueAfterLoop(int reg) {
+            auto found = afterLoop.find(reg);
+            if (found != afterLoop.end()) {
+                return found->second;
+            }
+            Value value = join(exit, reg);
+            afterLoop[reg] = value;
+            resolveLatchValues(exit->first);
+            return value;
+        }
+
+        // The values a new phi takes from the loop may be header registers, which are the loop's own phis there
+        void resolveLatchValues(Instruction *phi) {
+            for (unsigned i = 0; i < phi->numOps; i++) {
+                if (isHeaderValue(phi->ops[i])) {
+                    phi->ops[i] = valueInLoop(phi->ops[i].n);
+                }
+            }
+        }
+
+        // Gives the phis of a successor of the header an incoming value from every side that reaches it instead
+        void redirectPhis(Block *block, Block *header) {
+            for (Instruction *phi = block->first; phi && phi->op == Opcode::PHI; phi = phi->next) {
+                std::vector<Value> ops;
+                std::vector<Block *> targets;
+                for (unsigned i = 0; i < phi->numOps; i++) {
+                    if (phi->targets[i] != header) {
+                        ops.push_back(phi->ops[i]);
+                        targets.push_back(phi->targets[i]);
+                        continue;
+                    }
+                    for (unsigned side = 0; side < sides.size(); side++) {
+                        if (reaches(sides[side], block)) {
+                            ops.push_back(versionAt(side, phi->ops[i]));
+                            targets.push_back(sides[side]);
+                        }
+                    }
+                }
+                phi->numOps = phi->numTargets = ops.size();
+                phi->ops = function.arena.array<Value>(ops.size());
+                phi->targets = function.arena.array<Block *>(ops.size());
+                std::copy(ops.begin(), ops.end(), phi->ops);
+                std::copy(targets.begin(), targets.end(), phi->targets);
+            }
+        }
+
+        bool canRotate(const Cfg &cfg) {
+            Block *header = loop->header;
+            Instruction *test = header->last;
+            if (test->op != Opcode::CONDBR) {
+                return false;
+            }
+            unsigned inside = loop->contains[test->targets[0]->id] ? 0 : 1;
+            body = test->targets[inside];
+            exit = test->targets[1 - inside];
+            if (loop->contains[exit->id] || body == header || cfg.preds[body->id].size() != 1) {
+                return false;
+            }
+            // The loop is left for the exit only, so the phis there can give the header's values to all the code after
+            breaks.clear();
+            for (Block *block: loop->blocks) {
+                for (Block *succ: successors(block)) {
+                    if (!loop->contains[succ->id] && succ != exit) {
+                        return false;
+                    }
+                    if (succ == exit && block != header) {
+                        breaks.push_back(block);
+                    }
+                }
+            }
+            if (cfg.preds[exit->id].size() != breaks.size() + 1) {
+                return false;
+            }
+            sides.clear();
+            sides.push_back(nullptr);
+            for (Block *pred: cfg.preds[header->id]) {
+                if (pred->last->op != Opcode::BR) {
+                    return false;
+                }
+                if (!loop->contains[pred->id]) {
+                    if (sides[0]) {
+                        return false;
+                    }
+                    sides[0] = pred;
+                } else {
+                    sides.push_back(pred);
+                }
+            }
+            for (Instruction *instruction = header->first; instruction != test; instruction = instruction->next) {
+                if (instruction->op != Opcode::PHI && !isPure(instruction)) {
+                    return false;
+                }
+            }
+            return sides[0] != nullptr;
+        }
+
+        void rotate() {
+            Block *header = loop->header;
+            Instruction *test = header->last;
+            inHeader.assign(function.regTypes.size(), false);
+            versions.assign(sides.size(), {});
+            inLoop.clear();
+            afterLoop.clear();
+
+            // The test is copied to the end of every side, with the values the header's registers have there
+            for (Instruction *instruction = header->first; instruction != test; instruction = instruction->next) {
+                inHeader[instruction->result] = true;
+                for (unsigned side = 0; side < sides.size(); side++) {
+                    if (instruction->op == Opcode::PHI) {
+                        unsigned i = std::find(instruction->targets, instruction->targets + instruction->numTargets,
+                                               sides[side]) - instruction->targets;
+                        versions[side][instruction->result] = instruction->ops[i];
+                        continue;
+                    }
+                    Value ops[2];
+                    bool constant = true;
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        ops[i] = versionAt(side, instruction->ops[i]);
+                        constant = constant && ops[i].isConst();
+                    }
+                    Value folded;
+                    if (constant && fold(instruction->op, instruction->type, instruction->pred, ops, folded)) {
+                        versions[side][instruction->result] = folded;
+                        continue;
+                    }
+                    // A latch reuses the preheader's copy when it computes the same thing, as the preheader
+                    // dominates the loop
+                    if (side > 0 && isInvariantCopy(instruction, ops)) {
+                        versions[side][instruction->result] = versions[0][instruction->result];
+                        continue;
+                    }
+                    Value result = function.newReg(instruction->type);
+                    Instruction *copy = function.create(instruction->op, instruction->type, result.n,
+                                                        std::vector<Value>(ops, ops + instruction->numOps));
+                    copy->pred = instruction->pred;
+                    sides[side]->insertBefore(sides[side]->last, copy);
+                    versions[side][instruction->result] = result;
+                }
+            }
+            for (unsigned side = 0; side < sides.size(); side++) {
+                Block *block = sides[side];
+                Value cond = versionAt(side, test->ops[0]);
+                block->remove(block->last);
+                if (cond.isConst()) {
+                    block->append(function.create(Opcode::BR, Type::VOID, -1, {},
+                                                  {test->targets[cond.n ? 0 : 1]}));
+                } else {
+                    block->append(function.create(Opcode::CONDBR, Type::VOID, -1, {cond},
+                                                  {test->targets[0], test->targets[1]}));
+                }
+            }
+            function.remove(header);
+            redirectPhis(body, header);
+            redirectPhis(exit, header);
+
+            // The uses of the header's registers now read the phis that join the copies. A phi uses its value at the
+            // end of the block it comes from
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        Value &op = instruction->ops[i];
+                        Block *at = instruction->op == Opcode::PHI ? instruction->targets[i] : block;
+                        if (isHeaderValue(op)) {
+                            op = loop->contains[at->id] ? valueInLoop(op.n) : valueAfterLoop(op.n);
+                        }
+                    }
+                }
+            }
+        }
+
+        // Whether the preheader's copy of the instruction has exactly the given operands
+        bool isInvariantCopy(const Instruction *instruction, const Value *ops) {
+            for (unsigned i = 0; i < instruction->numOps; i++) {
+                if (!same(ops[i], versionAt(0, instruction->ops[i]))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    public:
+        explicit LoopRotation(Function &function) : function(function) {}
+
+        void run() {
+            bool rotated = true;
+            while (rotated) {
+                rotated = false;
+                Cfg cfg(function);
+                std::vector<Loop> loops = findLoops(function, cfg);
+                for (const Loop &candidate: loops) {
+                    loop = &candidate;
+                    if (canRotate(cfg)) {
+                        rotate();
+                        // The blocks changed, so the loops are found again
+                        rotated = true;
+                        break;
+                    }
+                }
+            }
+        }
+    };
+
+    void rotateLoops(Function &function) {
+        LoopRotation(function).run();
+    }
+
+    void hoistInvariants(Function &function) {
+        Cfg cfg(function);
+        std::vector<Loop> loops = findLoops(function, cfg);
+        // The block of every register's definition, nullptr for the parameters
+        std::vector<Block *> definedIn(function.regTypes.size(), nullptr);
+        for (Block *block = function.first; block; block = block->next) {
+            for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                if (instruction->result >= 0) {
+                    definedIn[instruction->result] = block;
+                }
+            }
+        }
+        // Inner loops come first, so what leaves an inner loop can leave the loops around it as well
+        for (const Loop &loop: loops) {
+            Block *preheader = nullptr;
+            for (Block *pred: cfg.preds[loop.header->id]) {
+                if (!loop.contains[pred->id]) {
+                    preheader = preheader ? nullptr : pred;
+                    if (!preheader) {
+                        break;
+                    }
+                }
+            }
+            if (!preheader) {
+                continue;
+            }
+            // In reverse postorder, an instruction's operands from the loop are seen before it
+            for (Block *block: loop.blocks) {
+                Instruction *next;
+                for (Instruction *instruction = block->first; instruction; instruction = next) {
+                    next = instruction->next;
+                    if (!isSpeculatable(instruction)) {
+                        continue;
+                    }
+                    bool invariant = true;
+                    for (unsigned i = 0; invariant && i < instruction->numOps; i++) {
+                        const Value &op = instruction->ops[i];
+                        invariant = !op.isReg() || !definedIn[op.n] || !loop.contains[definedIn[op.n]->id];
+                    }
+                    if (invariant) {
+                        block->remove(instruction);
+                        preheader->insertBefore(preheader->last, instruction);
+                        definedIn[instruction->result] = preheader;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef ATTRIBUTES_HPP
+#define ATTRIBUTES_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "nodes.hpp"
+
+namespace onepass {
+
+    /* Synthesized attributes of a grammar symbol.
+     * The single-pass parser carries these on the bison stack instead of building ast:: nodes,
+     * and emits LLVM IR from the semantic actions as soon as a construct is reduced.
+     */
+    class Tkhuna {
+    public:
+        // Line number in the source code, taken when the symbol was created
+        int line;
+        // Lexeme of ID tokens, or the contents of STRING tokens without the quotes
+        std::string shem;
+        // Value of NUM and NUM_B tokens
+        int value = 0;
+        // Type of an expression, or the type named by a Type / RetType symbol
+        ast::BuiltInType type = ast::BuiltInType::NOTHING;
+        // Register or constant that holds the value of an expression (its place)
+        ir::Value erekhBituy;
+        // Types and places of the elements of an ExpList, or types, names and lines of Formals
+        std::vector<ast::BuiltInType> tippusim;
+        std::vector<ir::Value> erakhim;
+        std::vector<std::string> shemot;
+        std::vector<int> shurot;
+        // Block handed from a mid-rule action to the end of its rule: the left operand of and/or, a while condition
+        ir::Block *taviyotRishona = nullptr;
+        // True when a bool expression was lowered as jumps (and/or/not): its value is in reshimatEmet and reshimatSheker
+        // instead of erekhBituy until it is materialized
+        bool kfitsot = false;
+        // Jumps waiting for their target: true and false exits of a condition, and the jump past an else
+        ir::PatchList reshimatEmet;
+        ir::PatchList reshimatSheker;
+        ir::PatchList reshimatHamshekh;
+
+        // Use this constructor only while parsing in bison or flex
+        Tkhuna();
+
+        // Constructor for Type symbols and typed expressions
+        explicit Tkhuna(ast::BuiltInType type);
+    };
+
+    /* Signature of a function, collected before parsing so that calls may precede definitions */
+    struct Hatima {
+        std::string shem;
+        ast::BuiltInType returnType;
+        std::vector<ast::BuiltInType> paramTypes;
+        int line;
+        // Names the body calls, for the order of the inlining (see inliner.hpp)
+        std::vector<std::string> nikraim;
+    };
+
+    // Signatures in declaration order, including print and printi
+    extern std::vector<Hatima> hatimot;
+
+    // Returns the signature of a function, or nullptr if no function has this name
+    const Hatima *findFunction(const std::string &shem);
+
+    // Reports duplicate functions and a missing main exactly like the AST pipeline does.
+    // Called once, when the parser reaches the first function (or the end of an empty program).
+    void bdikatHatsharot();
+
+    // Moves the code in the buffer to the module
+    void commit();
+
+    // Prints a function after its passes into the module, its string constants named by the module's pool
+    void commit(const ir::Function &function);
+}
+
+// nodes.hpp defines YYSTYPE for the AST parser; the single-pass parser carries attributes instead
+#undef YYSTYPE
+#define YYSTYPE std::shared_ptr<onepass::Tkhuna>
+
+#endif //ATTRIBUTES_HPP
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <iterator>
+#include "output.hpp"
+#include "attributes.hpp"
+#include "parser.tab.h"
+
+// Extern from the bison-generated parser and the flex-generated scanner
+extern int yyparse();
+extern int yylex();
+extern int yylineno;
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+extern YY_BUFFER_STATE yy_scan_string(const char *str);
+extern void yy_delete_buffer(YY_BUFFER_STATE buffer);
+
+// The code buffer every code generation helper emits into, it holds the function being generated
+output::CodeBuffer buffer;
+
+namespace onepass {
+
+    // The string constants of the module go through one pool like in the AST build (see parallelgen.hpp), so both
+    // builds print the same module
+    static output::CodeBuffer module;
+    static output::StringPool pool(module);
+    // The code committed so far
+    static output::Rope kod;
+
+    void commit() {
+        kod.splice(buffer.releaseCode());
+    }
+
+    void commit(const ir::Function &function) {
+        ir::print(function, buffer, pool);
+        commit();
+    }
+
+    Tkhuna::Tkhuna() : line(yylineno) {}
+
+    Tkhuna::Tkhuna(ast::BuiltInType type) : line(yylineno), type(type) {}
+
+    std::vector<Hatima> hatimot;
+
+    const Hatima *findFunction(const std::string &shem) {
+        for (const Hatima &hatima: hatimot) {
+            if (hatima.shem == shem) {
+                return &hatima;
+            }
+        }
+        return nullptr;
+    }
+
+    static bool zeTippus(int token) {
+        return token == INT || token == BYTE || token == BOOL;
+    }
+
+    // Collects the signature of every top-level function from the token stream, and the calls in its body (an ID
+    // followed by a parenthesis). Only headers at brace depth 0 are looked at; anything malformed is left for the real
+    // parse to report.
+    static std::vector<Hatima> skiratHatimot() {
+        std::vector<Hatima> nimtsau;
+        int omek = 0;
+        int token = yylex();
+        while (token) {
+            if (omek == 0 && (token == VOID || zeTippus(token))) {
+                Hatima hatima;
+                hatima.returnType = token == VOID ? ast::VOID : token == INT ? ast::INT : token == BYTE ? ast::BYTE : ast::BOOL;
+                if ((token = yylex()) != ID) {
+                    continue;
+                }
+                hatima.shem = yylval->shem;
+                hatima.line = yylval->line;
+                if ((token = yylex()) != LPAREN) {
+                    continue;
+                }
+                token = yylex();
+                while (zeTippus(token)) {
+                    hatima.paramTypes.push_back(token == INT ? ast::INT : token == BYTE ? ast::BYTE : ast::BOOL);
+                    if ((token = yylex()) != ID || (token = yylex()) != COMMA) {
+                        break;
+                    }
+                    token = yylex();
+                }
+                if (token != RPAREN) {
+                    continue;
+                }
+                nimtsau.push_back(hatima);
+            } else if (token == ID && omek > 0 && !nimtsau.empty()) {
+                std::string shem = yylval->shem;
+                if ((token = yylex()) == LPAREN) {
+                    nimtsau.back().nikraim.push_back(shem);
+                }
+                continue;
+            } else if (token == LBRACE) {
+                omek++;
+            } else if (token == RBRACE) {
+                omek--;
+            }
+            token = yylex();
+        }
+        return nimtsau;
+    }
+
+    static std::vector<Hatima> kolHatsharot;
+
+    void bdikatHatsharot() {
+        static bool nivdak = false;
+        if (nivdak) {
+            return;
+        }
+        nivdak = true;
+
+        bool mainKayyam = false;
+        hatimot = {{"print", ast::VOID, {ast::STRING}, 0, {}}, {"printi", ast::VOID, {ast::INT}, 0, {}}};
+        for (const Hatima &hatima: kolHatsharot) {
+            if (hatima.shem == "main") {
+                mainKayyam = true;
+                if (!hatima.paramTypes.empty() || hatima.returnType != ast::VOID) {
+                    output::errorMainMissing();
+                }
+            }
+            if (findFunction(hatima.shem)) {
+                output::errorDef(hatima.line, hatima.shem);
+            }
+            hatimot.push_back(hatima);
+        }
+        if (!mainKayyam) {
+            output::errorMainMissing();
+        }
+    }
+}
+
+int main() {
+    try {
+        // The source is lexed twice: once for the function signatures, once for the real parse
+        std::string makor((std::istreambuf_iterator<char>(std::cin)), std::istreambuf_iterator<char>());
+
+        YY_BUFFER_STATE skira = yy_scan_string(makor.c_str());
+        onepass::kolHatsharot = onepass::skiratHatimot();
+        yy_delete_buffer(skira);
+
+        yylineno = 1;
+        YY_BUFFER_STATE nituah = yy_scan_string(makor.c_str());
+        yyparse();
+        yy_delete_buffer(nituah);
+
+        // The string constants come after the functions, followed by the empty line of the globals
+        onepass::kod.writeTo(std::cout);
+        std::cout << onepass::module;
+    } catch (const output::CompileError &e) {
+        std::cout << e.what();
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
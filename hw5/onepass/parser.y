@@ -0,0 +1,505 @@
+%{
+#include <iostream>
+#include <string>
+#include "output.hpp"
+#include "generator.hpp"
+#include "attributes.hpp"
+
+// bison declarations
+extern int yylineno;
+extern int yylex();
+void yyerror(const char*);
+extern output::CodeBuffer buffer;
+
+using namespace std;
+using namespace onepass;
+using namespace output;
+
+// The single-pass parser lowers every construct as soon as it is reduced, with the same
+// emission helpers the AST visitor uses, so no ast:: nodes are ever built.
+LLVM_code_generator generator(buffer);
+
+// Return type of the function whose body is being parsed
+static BuiltInType returnType;
+
+// The finished functions the generator inlines from, created once the signatures are known
+static unique_ptr<ir::InlineLibrary> library;
+
+// The functions by position in the program, from the end of their lowering until they are printed. They are optimized
+// in the library's order, callees first, and printed in program order (see inliner.hpp)
+static vector<shared_ptr<ir::Function>> funktsiyot;
+static vector<bool> meshuparot;
+// The number of functions lowered, the position in the library's order of the next function to optimize, and the
+// number of functions printed
+static size_t horadu = 0, haBaBaSeder = 0, hudpesu = 0;
+
+// Takes the function the generator just ended, and optimizes and prints every function whose turn it completes
+static void siyumFunktsiya() {
+    funktsiyot[horadu++] = generator.releaseFunction();
+    const vector<size_t> &seder = library->order();
+    while (haBaBaSeder < seder.size() && funktsiyot[seder[haBaBaSeder]]) {
+        generator.optimize(funktsiyot[seder[haBaBaSeder]]);
+        meshuparot[seder[haBaBaSeder++]] = true;
+    }
+    while (hudpesu < funktsiyot.size() && meshuparot[hudpesu]) {
+        commit(*funktsiyot[hudpesu]);
+        funktsiyot[hudpesu++].reset();
+    }
+}
+
+static bool mispari(BuiltInType type) {
+    return type == ast::BuiltInType::INT || type == ast::BuiltInType::BYTE;
+}
+
+// Whether a value of type `from` may be stored into a variable / parameter of type `to`
+static bool nitanLehasim(BuiltInType to, BuiltInType from) {
+    return to == from || (to == ast::BuiltInType::INT && from == ast::BuiltInType::BYTE);
+}
+
+static string tippusLeHodaa(BuiltInType type) {
+    switch (type) {
+        case ast::BuiltInType::BOOL:
+            return "BOOL";
+        case ast::BuiltInType::BYTE:
+            return "BYTE";
+        case ast::BuiltInType::INT:
+            return "INT";
+        case ast::BuiltInType::STRING:
+            return "STRING";
+        default:
+            return "VOID";
+    }
+}
+
+// Reports every way an identifier used as a variable can be wrong, and returns the variable otherwise
+static const LLVM_code_generator::MishtaneBaMisgeret *mishtaneKayyam(const Tkhuna &id) {
+    const LLVM_code_generator::MishtaneBaMisgeret *mishtane = generator.lookup(id.shem);
+    if (!mishtane) {
+        if (findFunction(id.shem)) {
+            errorDefAsFunc(id.line, id.shem);
+        }
+        errorUndef(id.line, id.shem);
+    }
+    return mishtane;
+}
+
+// Declaration checks shared by both forms of VarDecl
+static void hatsharatMishtane(const Tkhuna &id, int line) {
+    if (generator.lookup(id.shem)) {
+        errorDef(line, id.shem);
+    }
+    if (findFunction(id.shem)) {
+        errorDefAsFunc(line, id.shem);
+    }
+}
+
+static shared_ptr<Tkhuna> binop(const Tkhuna &left, const Tkhuna &right, ast::BinOpType op) {
+    auto res = make_shared<Tkhuna>();
+    if (!mispari(left.type) || !mispari(right.type)) {
+        errorMismatch(res->line);
+    }
+    bool shneiHemByte = left.type == ast::BuiltInType::BYTE && right.type == ast::BuiltInType::BYTE;
+    res->type = shneiHemByte ? ast::BuiltInType::BYTE : ast::BuiltInType::INT;
+    res->erekhBituy = generator.binop_code(res->type, left.erekhBituy, right.erekhBituy, op);
+    return res;
+}
+
+static shared_ptr<Tkhuna> relop(const Tkhuna &left, const Tkhuna &right, ast::RelOpType op) {
+    auto res = make_shared<Tkhuna>(ast::BuiltInType::BOOL);
+    if (!mispari(left.type) || !mispari(right.type)) {
+        errorMismatch(res->line);
+    }
+    res->erekhBituy = generator.relop_code(left.erekhBituy, right.erekhBituy, op);
+    return res;
+}
+
+// Moves the jumps of a bool expression into the lists, branching on its value if it has one
+static void kfitsot(Tkhuna &exp, ir::PatchList &trueList, ir::PatchList &falseList) {
+    if (exp.kfitsot) {
+        ir::merge(trueList, exp.reshimatEmet);
+        ir::merge(falseList, exp.reshimatSheker);
+        exp.kfitsot = false;
+    } else {
+        generator.jump_code(exp.erekhBituy, trueList, falseList);
+    }
+}
+
+// Value of an expression, joining the jumps of and/or/not with a phi where it is needed
+static ir::Value erekh(Tkhuna &exp) {
+    if (exp.kfitsot) {
+        exp.erekhBituy = generator.materialize(exp.reshimatEmet, exp.reshimatSheker);
+        exp.kfitsot = false;
+    }
+    return exp.erekhBituy;
+}
+
+// Opens the right operand of and/or; the pending jumps of the left operand travel in the mid-rule value
+static shared_ptr<Tkhuna> boolBegin(Tkhuna &left, bool is_and) {
+    auto res = make_shared<Tkhuna>();
+    kfitsot(left, res->reshimatEmet, res->reshimatSheker);
+    generator.bool_jump_begin(is_and, res->reshimatEmet, res->reshimatSheker);
+    return res;
+}
+
+static shared_ptr<Tkhuna> boolEnd(const Tkhuna &left, Tkhuna &labels, Tkhuna &right) {
+    auto res = make_shared<Tkhuna>(ast::BuiltInType::BOOL);
+    if (left.type != ast::BuiltInType::BOOL || right.type != ast::BuiltInType::BOOL) {
+        errorMismatch(res->line);
+    }
+    kfitsot(right, labels.reshimatEmet, labels.reshimatSheker);
+    res->kfitsot = true;
+    res->reshimatEmet = std::move(labels.reshimatEmet);
+    res->reshimatSheker = std::move(labels.reshimatSheker);
+    return res;
+}
+
+static shared_ptr<Tkhuna> call(const Tkhuna &id, const Tkhuna &args) {
+    auto res = make_shared<Tkhuna>();
+    const Hatima *hatima = findFunction(id.shem);
+    bool mathim = hatima->paramTypes.size() == args.tippusim.size();
+    for (size_t i = 0; mathim && i < args.tippusim.size(); i++) {
+        mathim = nitanLehasim(hatima->paramTypes[i], args.tippusim[i]);
+    }
+    if (!mathim) {
+        vector<string> tippusim;
+        for (BuiltInType type: hatima->paramTypes) {
+            tippusim.push_back(tippusLeHodaa(type));
+        }
+        errorPrototypeMismatch(res->line, id.shem, tippusim);
+    }
+    res->type = hatima->returnType;
+    res->erekhBituy = generator.call_code(hatima->returnType, id.shem, args.tippusim, args.erakhim);
+    return res;
+}
+%}
+
+// Define tokens here
+%token VOID
+%token INT
+%token BYTE
+%token BOOL
+%token AND
+%token OR
+%token NOT
+%token TRUE
+%token FALSE
+%token RETURN
+%token IF
+%token ELSE
+%token WHILE
+%token BREAK
+%token CONTINUE
+%token SC
+%token COMMA
+%token LPAREN
+%token RPAREN
+%token LBRACE
+%token RBRACE
+%token ASSIGN
+%token ID
+%token NUM
+%token NUM_B
+%token STRING
+%token R_EQ
+%token R_NE
+%token R_LT
+%token R_GT
+%token R_LE
+%token R_GE
+%token B_ADD
+%token B_SUB
+%token B_MUL
+%token B_DIV
+// Define precedence and associativity here
+%right ASSIGN
+%left OR
+%left AND
+%left R_EQ R_NE
+%left R_LT R_GT R_LE R_GE
+%left B_ADD B_SUB
+%left B_MUL B_DIV
+%right NOT
+%left LPAREN RPAREN LBRACE RBRACE
+
+
+%nonassoc ELSE
+%nonassoc IF
+%%
+
+// An empty program still has to report the missing main
+Program:  { generator.globalFunctions(); commit(); } Funcs { bdikatHatsharot(); }
+;
+
+// Grammar for functions. Left recursive, so the parser stack does not grow with the number of
+// functions: each one is lowered when it is reduced, and only its IR is kept until its turn to be printed.
+Funcs:      { }
+        | Funcs FuncDecl { }
+;
+
+// Function declarations: the header opens the function, the closing brace ends it
+FuncDecl: FuncHead LBRACE Statements RBRACE { generator.endScope(); generator.function_end(); siyumFunktsiya(); }
+;
+
+FuncHead: RetType ID LPAREN Formals RPAREN {
+            bdikatHatsharot();
+            for (size_t i = 0; i < $4->shemot.size(); i++) {
+                for (size_t j = 0; j < i; j++) {
+                    if ($4->shemot[j] == $4->shemot[i]) {
+                        errorDef($4->shurot[i], $4->shemot[i]);
+                    }
+                }
+                if (findFunction($4->shemot[i])) {
+                    errorDef($4->shurot[i], $4->shemot[i]);
+                }
+            }
+            if (!library) {
+                // The signatures of print and printi come first, their code is not generated
+                vector<string> shemot;
+                vector<vector<string>> nikraim;
+                for (size_t i = 2; i < hatimot.size(); i++) {
+                    shemot.push_back(hatimot[i].shem);
+                    nikraim.push_back(hatimot[i].nikraim);
+                }
+                library.reset(new ir::InlineLibrary(shemot, nikraim));
+                generator.inlineFrom(library.get());
+                funktsiyot.resize(shemot.size());
+                meshuparot.resize(shemot.size());
+            }
+            returnType = $1->type;
+            generator.function_begin($2->shem, $1->type, $4->tippusim);
+            generator.beginScope();
+            for (size_t i = 0; i < $4->shemot.size(); i++) {
+                generator.declare_param($4->shemot[i], $4->tippusim[i]);
+            }
+        }
+;
+
+// Return type for functions
+RetType: Type { $$ = $1; }
+        | VOID { $$ = make_shared<Tkhuna>(ast::BuiltInType::VOID); }
+;
+
+// Formals for function parameters
+Formals: { $$ = make_shared<Tkhuna>(); }
+         | FormalsList { $$ = $1; }
+;
+
+FormalsList: FormalDecl { $$ = $1; }
+           | FormalDecl COMMA FormalsList {
+                $$ = $3;
+                $$->tippusim.insert($$->tippusim.begin(), $1->tippusim.front());
+                $$->shemot.insert($$->shemot.begin(), $1->shemot.front());
+                $$->shurot.insert($$->shurot.begin(), $1->shurot.front());
+            }
+;
+
+// Formal declaration for parameters
+FormalDecl: Type ID { $$ = make_shared<Tkhuna>(); $$->tippusim = {$1->type}; $$->shemot = {$2->shem}; $$->shurot = {$2->line}; }
+;
+
+// Statements block
+Statements: Statement { }
+         | Statements Statement { }
+;
+
+// Single statement rule
+Statement: LBRACE { generator.beginScope(); } Statements RBRACE { generator.endScope(); }
+         | Type ID SC {
+                int line = yylineno;
+                hatsharatMishtane(*$2, line);
+                generator.declare_var($2->shem, $1->type, LLVM_code_generator::default_value($1->type));
+            }
+         | Type ID ASSIGN Exp SC {
+                int line = yylineno;
+                hatsharatMishtane(*$2, line);
+                if (!nitanLehasim($1->type, $4->type)) {
+                    errorMismatch(line);
+                }
+                generator.declare_var($2->shem, $1->type, erekh(*$4));
+            }
+         | AssignHead Exp SC {
+                if (!nitanLehasim($1->type, $2->type)) {
+                    errorMismatch(yylineno);
+                }
+                generator.store_code(*generator.lookup($1->shem), erekh(*$2));
+            }
+         | Call SC { }
+         | RETURN SC {
+                if (returnType != ast::BuiltInType::VOID) {
+                    errorMismatch(yylineno);
+                }
+                generator.return_code(ast::BuiltInType::VOID, ir::Value());
+            }
+         | RETURN Exp SC {
+                if (!nitanLehasim(returnType, $2->type)) {
+                    errorMismatch(yylineno);
+                }
+                generator.return_code($2->type, erekh(*$2));
+            }
+         // RPAREN is the precedence the AST grammar's if rule gets from its last token, so ELSE is shifted
+         | IfHead Statement %prec RPAREN {
+                generator.endScope();
+                ir::backpatch($1->reshimatSheker, generator.emitLabel());
+            }
+         | IfHead Statement ELSE {
+                generator.endScope();
+                $$ = make_shared<Tkhuna>();
+                generator.branch($$->reshimatHamshekh);
+                ir::backpatch($1->reshimatSheker, generator.emitLabel());
+                generator.beginScope();
+            } Statement {
+                generator.endScope();
+                ir::backpatch($4->reshimatHamshekh, generator.emitLabel());
+            }
+         | WhileHead Statement {
+                ir::PatchList breaks = generator.loop_end();
+                generator.branch($1->taviyotRishona);
+                generator.endScope();
+                ir::Block *endLabel = generator.emitLabel();
+                ir::backpatch($1->reshimatSheker, endLabel);
+                ir::backpatch(breaks, endLabel);
+            }
+         | BREAK SC {
+                if (!generator.inside_loop()) {
+                    errorUnexpectedBreak(yylineno);
+                }
+                generator.break_code();
+            }
+         | CONTINUE SC {
+                if (!generator.inside_loop()) {
+                    errorUnexpectedContinue(yylineno);
+                }
+                generator.continue_code();
+            }
+;
+
+// The assigned variable is checked before its value, like the AST pipeline does
+AssignHead: ID ASSIGN { $$ = $1; $$->type = mishtaneKayyam(*$1)->type; }
+;
+
+// Condition of an if: branches to the then-part, reshimatSheker waits for the else-part / end
+IfHead: IF LPAREN Exp RPAREN {
+            if ($3->type != ast::BuiltInType::BOOL) {
+                errorMismatch($3->line);
+            }
+            generator.beginScope();
+            $$ = make_shared<Tkhuna>();
+            kfitsot(*$3, $$->reshimatEmet, $$->reshimatSheker);
+            ir::backpatch($$->reshimatEmet, generator.emitLabel());
+        }
+;
+
+// Condition of a while: taviyotRishona is the condition block, reshimatSheker waits for the loop exit
+WhileHead: WhileCond LPAREN Exp RPAREN {
+            if ($3->type != ast::BuiltInType::BOOL) {
+                errorMismatch($3->line);
+            }
+            $$ = $1;
+            kfitsot(*$3, $$->reshimatEmet, $$->reshimatSheker);
+            ir::backpatch($$->reshimatEmet, generator.emitLabel());
+            generator.loop_begin($$->taviyotRishona);
+        }
+;
+
+WhileCond: WHILE {
+            $$ = make_shared<Tkhuna>();
+            generator.beginScope();
+            $$->taviyotRishona = generator.emitLabel();
+        }
+;
+
+// Function call
+Call: CallHead ExpList RPAREN { $$ = call(*$1, *$2); }
+         | CallHead RPAREN { $$ = call(*$1, Tkhuna()); }
+;
+
+// The callee is checked before its arguments, like the AST pipeline does
+CallHead: ID LPAREN {
+            if (generator.lookup($1->shem)) {
+                errorDefAsVar($1->line, $1->shem);
+            }
+            if (!findFunction($1->shem)) {
+                errorUndefFunc($1->line, $1->shem);
+            }
+            $$ = $1;
+        }
+;
+
+// Expression list
+// Every argument is materialized before the next one is lowered
+ExpList: Exp { $$ = make_shared<Tkhuna>(); $$->tippusim = {$1->type}; $$->erakhim = {erekh(*$1)}; }
+         | Exp COMMA { erekh(*$1); } ExpList {
+                $$ = $4;
+                $$->tippusim.insert($$->tippusim.begin(), $1->type);
+                $$->erakhim.insert($$->erakhim.begin(), $1->erekhBituy);
+            }
+;
+
+// Type definitions
+Type: INT { $$ = make_shared<Tkhuna>(ast::BuiltInType::INT); }
+        | BYTE { $$ = make_shared<Tkhuna>(ast::BuiltInType::BYTE); }
+        | BOOL { $$ = make_shared<Tkhuna>(ast::BuiltInType::BOOL); }
+;
+
+// Expression rules
+Exp: LPAREN Exp RPAREN { $$ = $2; }
+        | Exp B_ADD Exp { $$ = binop(*$1, *$3, ast::BinOpType::ADD); }
+        | Exp B_SUB Exp { $$ = binop(*$1, *$3, ast::BinOpType::SUB); }
+        | Exp B_MUL Exp { $$ = binop(*$1, *$3, ast::BinOpType::MUL); }
+        | Exp B_DIV Exp { $$ = binop(*$1, *$3, ast::BinOpType::DIV); }
+        | ID {
+            $$ = $1;
+            const LLVM_code_generator::MishtaneBaMisgeret *mishtane = mishtaneKayyam(*$1);
+            $$->type = mishtane->type;
+            $$->erekhBituy = generator.load_code(*mishtane);
+        }
+        | Call { $$ = $1; }
+        | NUM { $$ = $1; $$->type = ast::BuiltInType::INT; $$->erekhBituy = ir::Value::constant($1->value); }
+        | NUM_B {
+            if ($1->value >= 256) {
+                errorByteTooLarge($1->line, $1->value);
+            }
+            $$ = $1;
+            $$->type = ast::BuiltInType::BYTE;
+            $$->erekhBituy = ir::Value::constant($1->value, ir::Type::I8);
+        }
+        | STRING { $$ = $1; $$->type = ast::BuiltInType::STRING; $$->erekhBituy = generator.string_code($1->shem); }
+        | TRUE { $$ = make_shared<Tkhuna>(ast::BuiltInType::BOOL); $$->erekhBituy = ir::Value::constant(1, ir::Type::I1); }
+        | FALSE { $$ = make_shared<Tkhuna>(ast::BuiltInType::BOOL); $$->erekhBituy = ir::Value::constant(0, ir::Type::I1); }
+        | NOT Exp {
+            $$ = make_shared<Tkhuna>(ast::BuiltInType::BOOL);
+            if ($2->type != ast::BuiltInType::BOOL) {
+                errorMismatch($$->line);
+            }
+            if ($2->kfitsot) {
+                // A negated condition is the same jumps with the lists swapped
+                $$->kfitsot = true;
+                $$->reshimatEmet = std::move($2->reshimatSheker);
+                $$->reshimatSheker = std::move($2->reshimatEmet);
+            } else {
+                $$->erekhBituy = generator.not_code($2->erekhBituy);
+            }
+        }
+        | Exp AND { $$ = boolBegin(*$1, true); } Exp { $$ = boolEnd(*$1, *$3, *$4); }
+        | Exp OR { $$ = boolBegin(*$1, false); } Exp { $$ = boolEnd(*$1, *$3, *$4); }
+        | Exp R_EQ Exp { $$ = relop(*$1, *$3, ast::RelOpType::EQ); }
+        | Exp R_NE Exp { $$ = relop(*$1, *$3, ast::RelOpType::NE); }
+        | Exp R_LT Exp { $$ = relop(*$1, *$3, ast::RelOpType::LT); }
+        | Exp R_GT Exp { $$ = relop(*$1, *$3, ast::RelOpType::GT); }
+        | Exp R_LE Exp { $$ = relop(*$1, *$3, ast::RelOpType::LE); }
+        | Exp R_GE Exp { $$ = relop(*$1, *$3, ast::RelOpType::GE); }
+        | LPAREN Type RPAREN Exp {
+            $$ = make_shared<Tkhuna>($2->type);
+            if (!mispari($4->type) || !mispari($2->type)) {
+                errorMismatch($$->line);
+            }
+            $$->erekhBituy = generator.cast_code($4->type, $2->type, $4->erekhBituy);
+        }
+;
+
+%%
+
+// Error reporting
+void yyerror(const char* message) {
+    errorSyn(yylineno);
+}
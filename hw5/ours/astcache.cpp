@@ -0,0 +1,613 @@
+#include "astcache.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace astcache {
+
+    static const char MAGIC[4] = {'F', 'A', 'S', 'T'};
+    // Bump whenever the encoding of a node changes, old files are then ignored
+    static const unsigned char GIRSA = 3;
+
+    enum Tag : unsigned char {
+        NUM, NUM_B, STRING, BOOL, ID, BIN_OP, REL_OP, NOT, AND, OR, TYPE, CAST, EXP_LIST, CALL,
+        STATEMENTS, BREAK, CONTINUE, RETURN, IF, WHILE, VAR_DECL, ASSIGN, FORMAL, FORMALS, FUNC_DECL, FUNCS
+    };
+
+    // Written after MAGIC: the version and the number of values of every enumeration in the encoding, so a file from
+    // before one of them changed is ignored without a bump
+    static const unsigned char MIVNE[] = {GIRSA, FUNCS + 1, ast::NOTHING + 1, ast::DIV + 1, ast::GE + 1};
+
+    // A new kind of node needs a tag and its encoding in AstWriter and AstReader
+    static_assert(FUNCS == 25, "the AST classes changed: update the encoding, bump GIRSA and then this check");
+
+    static unsigned long long fnv1a(const unsigned char *pos, size_t size) {
+        unsigned long long hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= pos[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    unsigned long long hashMakor(const string &makor) {
+        return fnv1a((const unsigned char *) makor.data(), makor.size());
+    }
+
+    // MAGIC, MIVNE and the hash of the encoded tree. The tree is trusted like the output of the semantic analysis,
+    // and a flipped byte in a name or a type still decodes, so only a file whose hash matches is read
+    static const size_t KOTERET = sizeof(MAGIC) + sizeof(MIVNE) + sizeof(unsigned long long);
+
+    string cachePath(const string &dir, const string &makor) {
+        char shem[32];
+        snprintf(shem, sizeof(shem), "%016llx.fast", hashMakor(makor));
+        return dir + "/" + shem;
+    }
+
+    /* Serializes the AST in pre-order: a tag and the line of every node, then its fields and children */
+    class AstWriter : public Visitor {
+    private:
+        string &out;
+        bool withLines;
+        vector<string> *callees;
+
+        void varint(unsigned long long value) {
+            while (value >= 0x80) {
+                out += (char) (value | 0x80);
+                value >>= 7;
+            }
+            out += (char) value;
+        }
+
+        void mispar(int value) {
+            // Zigzag, so small negative numbers stay short
+            varint(((unsigned long long) value << 1) ^ (unsigned long long) (value >> 31));
+        }
+
+        void byte(unsigned char value) {
+            out += (char) value;
+        }
+
+        void str(const string &value) {
+            varint(value.size());
+            out += value;
+        }
+
+        void header(Tag tag, const ast::Node &node) {
+            byte(tag);
+            if (withLines) {
+                mispar(node.line);
+            }
+        }
+
+        void header(Tag tag, const ast::Exp &node) {
+            header(tag, (const ast::Node &) node);
+            byte(node.type);
+        }
+
+        void optional(ast::Node *node) {
+            byte(node != nullptr);
+            if (node) {
+                node->accept(*this);
+            }
+        }
+
+    public:
+        AstWriter(string &out, bool withLines, vector<string> *callees)
+                : out(out), withLines(withLines), callees(callees) {}
+
+        void visit(ast::Num &node) override {
+            header(NUM, node);
+            mispar(node.value);
+        }
+
+        void visit(ast::NumB &node) override {
+            header(NUM_B, node);
+            mispar(node.value);
+        }
+
+        void visit(ast::String &node) override {
+            header(STRING, node);
+            str(node.value);
+        }
+
+        void visit(ast::Bool &node) override {
+            header(BOOL, node);
+            byte(node.value);
+        }
+
+        void visit(ast::ID &node) override {
+            header(ID, node);
+            str(node.value);
+        }
+
+        void visit(ast::BinOp &node) override {
+            header(BIN_OP, node);
+            byte(node.op);
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(ast::RelOp &node) override {
+            header(REL_OP, node);
+            byte(node.op);
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(ast::Not &node) override {
+            header(NOT, node);
+            node.exp->accept(*this);
+        }
+
+        void visit(ast::And &node) override {
+            header(AND, node);
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(ast::Or &node) override {
+            header(OR, node);
+            node.left->accept(*this);
+            node.right->accept(*this);
+        }
+
+        void visit(ast::Type &node) override {
+            header(TYPE, node);
+            byte(node.type);
+        }
+
+        void visit(ast::Cast &node) override {
+            header(CAST, node);
+            node.exp->accept(*this);
+            node.target_type->accept(*this);
+        }
+
+        void visit(ast::ExpList &node) override {
+            header(EXP_LIST, node);
+            varint(node.exps.size());
+            for (const auto &exp: node.exps) {
+                exp->accept(*this);
+            }
+        }
+
+        void visit(ast::Call &node) override {
+            header(CALL, node);
+            if (callees) {
+                callees->push_back(node.func_id->value);
+            }
+            node.func_id->accept(*this);
+            node.args->accept(*this);
+        }
+
+        void visit(ast::Statements &node) override {
+            header(STATEMENTS, node);
+            byte(node.zeSograyim);
+            varint(node.statements.size());
+            for (const auto &statement: node.statements) {
+                statement->accept(*this);
+            }
+        }
+
+        void visit(ast::Break &node) override {
+            header(BREAK, node);
+        }
+
+        void visit(ast::Continue &node) override {
+            header(CONTINUE, node);
+        }
+
+        void visit(ast::Return &node) override {
+            header(RETURN, node);
+            optional(node.exp.get());
+        }
+
+        void visit(ast::If &node) override {
+            header(IF, node);
+            node.condition->accept(*this);
+            node.then->accept(*this);
+            optional(node.otherwise.get());
+        }
+
+        void visit(ast::While &node) override {
+            header(WHILE, node);
+            node.condition->accept(*this);
+            node.body->accept(*this);
+        }
+
+        void visit(ast::VarDecl &node) override {
+            header(VAR_DECL, node);
+            node.id->accept(*this);
+            node.type->accept(*this);
+            optional(node.init_exp.get());
+        }
+
+        void visit(ast::Assign &node) override {
+            header(ASSIGN, node);
+            node.id->accept(*this);
+            node.exp->accept(*this);
+        }
+
+        void visit(ast::Formal &node) override {
+            header(FORMAL, node);
+            node.id->accept(*this);
+            node.type->accept(*this);
+        }
+
+        void visit(ast::Formals &node) override {
+            header(FORMALS, node);
+            varint(node.formals.size());
+            for (const auto &formal: node.formals) {
+                formal->accept(*this);
+            }
+        }
+
+        void visit(ast::FuncDecl &node) override {
+            header(FUNC_DECL, node);
+            node.id->accept(*this);
+            node.return_type->accept(*this);
+            node.formals->accept(*this);
+            node.body->accept(*this);
+        }
+
+        void visit(ast::Funcs &node) override {
+            header(FUNCS, node);
+            varint(node.funcs.size());
+            for (const auto &func: node.funcs) {
+                func->accept(*this);
+            }
+        }
+    };
+
+    /* Rebuilds the AST from the mapped file; every read is bounds checked, every tag and enumeration byte is range
+     * checked, and a malformed file throws
+     */
+    class AstReader {
+    private:
+        const unsigned char *pos;
+        const unsigned char *end;
+
+        void pagum() {
+            throw runtime_error("corrupt AST cache file");
+        }
+
+        unsigned char byte() {
+            if (pos == end) {
+                pagum();
+            }
+            return *pos++;
+        }
+
+        unsigned long long varint() {
+            unsigned long long value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                unsigned char b = byte();
+                value |= (unsigned long long) (b & 0x7f) << shift;
+                if (!(b & 0x80)) {
+                    return value;
+                }
+            }
+            pagum();
+            return 0;
+        }
+
+        int mispar() {
+            unsigned long long value = varint();
+            if (value >> 32) {
+                pagum();
+            }
+            return (int) ((value >> 1) ^ -(value & 1));
+        }
+
+        // A byte holding one of the first `values` values of an enumeration
+        unsigned char enumByte(unsigned values) {
+            unsigned char value = byte();
+            if (value >= values) {
+                pagum();
+            }
+            return value;
+        }
+
+        bool flag() {
+            return enumByte(2) != 0;
+        }
+
+        ast::BuiltInType builtInType() {
+            return (ast::BuiltInType) enumByte(ast::NOTHING + 1);
+        }
+
+        // The length of a list, each element takes at least a byte of what is left
+        unsigned long long length() {
+            unsigned long long value = varint();
+            if (value > (unsigned long long) (end - pos)) {
+                pagum();
+            }
+            return value;
+        }
+
+        string str() {
+            unsigned long long size = varint();
+            if (size > (unsigned long long) (end - pos)) {
+                pagum();
+            }
+            string value((const char *) pos, size);
+            pos += size;
+            return value;
+        }
+
+        template<typename T>
+        shared_ptr<T> child() {
+            shared_ptr<T> node = dynamic_pointer_cast<T>(readNode());
+            if (!node) {
+                pagum();
+            }
+            return node;
+        }
+
+        template<typename T>
+        shared_ptr<T> optional() {
+            return flag() ? child<T>() : nullptr;
+        }
+
+        shared_ptr<ast::Exp> exp(Tag tag, int line, ast::BuiltInType type) {
+            shared_ptr<ast::Exp> node;
+            switch (tag) {
+                case NUM: {
+                    auto num = make_shared<ast::Num>("0");
+                    num->value = mispar();
+                    node = num;
+                    break;
+                }
+                case NUM_B: {
+                    auto num = make_shared<ast::NumB>("0");
+                    num->value = mispar();
+                    // The semantic analysis rejects larger bytes before the AST is saved
+                    if (num->value < 0 || num->value > 255) {
+                        pagum();
+                    }
+                    node = num;
+                    break;
+                }
+                case STRING: {
+                    auto mahrozet = make_shared<ast::String>("\"\"");
+                    mahrozet->value = str();
+                    node = mahrozet;
+                    break;
+                }
+                case BOOL:
+                    node = make_shared<ast::Bool>(flag());
+                    break;
+                case ID:
+                    node = make_shared<ast::ID>(str().c_str());
+                    break;
+                case BIN_OP: {
+                    auto op = (ast::BinOpType) enumByte(ast::DIV + 1);
+                    auto left = child<ast::Exp>();
+                    node = make_shared<ast::BinOp>(left, child<ast::Exp>(), op);
+                    break;
+                }
+                case REL_OP: {
+                    auto op = (ast::RelOpType) enumByte(ast::GE + 1);
+                    auto left = child<ast::Exp>();
+                    node = make_shared<ast::RelOp>(left, child<ast::Exp>(), op);
+                    break;
+                }
+                case NOT:
+                    node = make_shared<ast::Not>(child<ast::Exp>());
+                    break;
+                case AND: {
+                    auto left = child<ast::Exp>();
+                    node = make_shared<ast::And>(left, child<ast::Exp>());
+                    break;
+                }
+                case OR: {
+                    auto left = child<ast::Exp>();
+                    node = make_shared<ast::Or>(left, child<ast::Exp>());
+                    break;
+                }
+                case CAST: {
+                    auto castExp = child<ast::Exp>();
+                    node = make_shared<ast::Cast>(castExp, child<ast::Type>());
+                    break;
+                }
+                default: {
+                    auto id = child<ast::ID>();
+                    node = make_shared<ast::Call>(id, child<ast::ExpList>());
+                    break;
+                }
+            }
+            node->line = line;
+            node->type = type;
+            return node;
+        }
+
+    public:
+        AstReader(const unsigned char *begin, const unsigned char *end) : pos(begin), end(end) {}
+
+        bool atEnd() const {
+            return pos == end;
+        }
+
+        shared_ptr<ast::Node> readNode() {
+            unsigned char tag = enumByte(FUNCS + 1);
+            int line = mispar();
+            if (tag <= CALL && tag != TYPE && tag != EXP_LIST) {
+                ast::BuiltInType type = builtInType();
+                return exp((Tag) tag, line, type);
+            }
+
+            shared_ptr<ast::Node> node;
+            switch (tag) {
+                case TYPE:
+                    node = make_shared<ast::Type>(builtInType());
+                    break;
+                case EXP_LIST: {
+                    auto list = make_shared<ast::ExpList>();
+                    for (unsigned long long i = length(); i > 0; i--) {
+                        list->push_back(child<ast::Exp>());
+                    }
+                    node = list;
+                    break;
+                }
+                case STATEMENTS: {
+                    auto statements = make_shared<ast::Statements>();
+                    statements->zeSograyim = flag();
+                    for (unsigned long long i = length(); i > 0; i--) {
+                        statements->push_back(child<ast::Statement>());
+                    }
+                    node = statements;
+                    break;
+                }
+                case BREAK:
+                    node = make_shared<ast::Break>();
+                    break;
+                case CONTINUE:
+                    node = make_shared<ast::Continue>();
+                    break;
+                case RETURN:
+                    node = make_shared<ast::Return>(optional<ast::Exp>());
+                    break;
+                case IF: {
+                    auto condition = child<ast::Exp>();
+                    auto then = child<ast::Statement>();
+                    node = make_shared<ast::If>(condition, then, optional<ast::Statement>());
+                    break;
+                }
+                case WHILE: {
+                    auto condition = child<ast::Exp>();
+                    node = make_shared<ast::While>(condition, child<ast::Statement>());
+                    break;
+                }
+                case VAR_DECL: {
+                    auto id = child<ast::ID>();
+                    auto type = child<ast::Type>();
+                    node = make_shared<ast::VarDecl>(id, type, optional<ast::Exp>());
+                    break;
+                }
+                case ASSIGN: {
+                    auto id = child<ast::ID>();
+                    node = make_shared<ast::Assign>(id, child<ast::Exp>());
+                    break;
+                }
+                case FORMAL: {
+                    auto id = child<ast::ID>();
+                    node = make_shared<ast::Formal>(id, child<ast::Type>());
+                    break;
+                }
+                case FORMALS: {
+                    auto formals = make_shared<ast::Formals>();
+                    for (unsigned long long i = length(); i > 0; i--) {
+                        formals->push_back(child<ast::Formal>());
+                    }
+                    node = formals;
+                    break;
+                }
+                case FUNC_DECL: {
+                    auto id = child<ast::ID>();
+                    auto returnType = child<ast::Type>();
+                    auto formals = child<ast::Formals>();
+                    node = make_shared<ast::FuncDecl>(id, returnType, formals, child<ast::Statements>());
+                    break;
+                }
+                case FUNCS: {
+                    auto funcs = make_shared<ast::Funcs>();
+                    for (unsigned long long i = length(); i > 0; i--) {
+                        funcs->push_back(child<ast::FuncDecl>());
+                    }
+                    node = funcs;
+                    break;
+                }
+                default:
+                    pagum();
+            }
+            node->line = line;
+            return node;
+        }
+    };
+
+    shared_ptr<ast::Funcs> load(const string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t) KOTERET) {
+            close(fd);
+            return nullptr;
+        }
+        size_t size = st.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return nullptr;
+        }
+
+        const unsigned char *begin = (const unsigned char *) mapped;
+        shared_ptr<ast::Funcs> program;
+        unsigned long long hash;
+        memcpy(&hash, begin + sizeof(MAGIC) + sizeof(MIVNE), sizeof(hash));
+        if (memcmp(begin, MAGIC, sizeof(MAGIC)) == 0 && memcmp(begin + sizeof(MAGIC), MIVNE, sizeof(MIVNE)) == 0 &&
+            hash == fnv1a(begin + KOTERET, size - KOTERET)) {
+            try {
+                AstReader reader(begin + KOTERET, begin + size);
+                program = dynamic_pointer_cast<ast::Funcs>(reader.readNode());
+                if (!reader.atEnd()) {
+                    program = nullptr;
+                }
+            } catch (const runtime_error &) {
+                program = nullptr;
+            }
+        }
+        munmap(mapped, size);
+        return program;
+    }
+
+    string serialize(ast::Node &node, bool withLines, vector<string> *callees) {
+        string out;
+        AstWriter writer(out, withLines, callees);
+        node.accept(writer);
+        return out;
+    }
+
+    bool writeAtomically(const string &path, const string &data) {
+        // Unique per thread as well, sessions of one process may write the same entry at once
+        string zmani = path + ".tmp." + to_string(getpid()) + "." +
+                       to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            // The stream buffers, so a full disk may only show when it is flushed: check after closing, or a
+            // truncated entry would be renamed into place and served from then on
+            ofstream file(zmani, ios::binary);
+            file.write(data.data(), data.size());
+            file.flush();
+            file.close();
+            if (file.fail()) {
+                remove(zmani.c_str());
+                return false;
+            }
+        }
+        if (rename(zmani.c_str(), path.c_str()) != 0) {
+            remove(zmani.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    void save(const string &path, ast::Funcs &program) {
+        string out(MAGIC, sizeof(MAGIC));
+        out.append((const char *) MIVNE, sizeof(MIVNE));
+        string etz = serialize(program, true, nullptr);
+        unsigned long long hash = hashMakor(etz);
+        out.append((const char *) &hash, sizeof(hash));
+        out += etz;
+        writeAtomically(path, out);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef ASTCACHE_HPP
+#define ASTCACHE_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "nodes.hpp"
+
+/* Binary AST cache (.fast files)
+ * After a successful front-end run the type-annotated AST is written to <dir>/<hash>.fast, where the hash is taken
+ * over the source text. A later run on the same source maps that file and rebuilds the AST from it,
+ * skipping lexing, parsing and semantic analysis.
+ */
+namespace astcache {
+
+    // 64-bit FNV-1a hash of the source text, also used as the key of the compile cache
+    unsigned long long hashMakor(const std::string &makor);
+
+    // Path of the cache file of the given source inside the cache directory
+    std::string cachePath(const std::string &dir, const std::string &makor);
+
+    // Loads a cached AST, returns nullptr if the file is missing, from another format version or corrupt
+    std::shared_ptr<ast::Funcs> load(const std::string &path);
+
+    // Encodes a subtree in the .fast format. Without lines the encoding only changes when the generated code can,
+    // and callees, when given, collects the names of the called functions
+    std::string serialize(ast::Node &node, bool withLines, std::vector<std::string> *callees = nullptr);
+
+    // Writes a file through a temporary file and a rename, so readers never see a partial file
+    bool writeAtomically(const std::string &path, const std::string &data);
+
+    // Writes the AST atomically (temporary file + rename); failures are ignored, the cache is only an optimization
+    void save(const std::string &path, ast::Funcs &program);
+}
+
+#endif //ASTCACHE_HPP
@@ -0,0 +1,181 @@
+#include "compilecache.hpp"
+#include "astcache.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace compilecache {
+
+    // Part of every key, bump whenever the emitted IR changes for the same source and options
+    static const char *GIRSAT_HAMAHDER = "hw5-ir-19";
+
+    struct Knisa {
+        string path;
+        unsigned long long godel;
+        struct timespec shimushAharon;
+    };
+
+    static vector<Knisa> knisot(const string &dir) {
+        vector<Knisa> result;
+        DIR *tikiyya = opendir(dir.c_str());
+        if (!tikiyya) {
+            return result;
+        }
+        while (struct dirent *entry = readdir(tikiyya)) {
+            string shem = entry->d_name;
+            if (shem.size() < 3 || shem.compare(shem.size() - 3, 3, ".ll") != 0) {
+                continue;
+            }
+            struct stat st;
+            string path = dir + "/" + shem;
+            if (stat(path.c_str(), &st) == 0) {
+                result.push_back({path, (unsigned long long) st.st_size, st.st_mtim});
+            }
+        }
+        closedir(tikiyya);
+        return result;
+    }
+
+    CompileCache::CompileCache(const string &dir, unsigned long long godelMaksimali)
+            : dir(dir), godelMaksimali(godelMaksimali) {}
+
+    bool CompileCache::lookup(const string &options, const string &makor) {
+        mafteakh = string(GIRSAT_HAMAHDER) + '\0' + options + '\0' + makor;
+        char shem[32];
+        snprintf(shem, sizeof(shem), "%016llx.ll", astcache::hashMakor(mafteakh));
+        path = dir + "/" + shem;
+
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            count(false);
+            return false;
+        }
+        void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            count(false);
+            return false;
+        }
+
+        // The entry starts with its key, another key with the same hash is a miss
+        const char *pos = (const char *) mapped;
+        size_t nishar = st.st_size;
+        size_t koteret = to_string(mafteakh.size()).size() + 1;
+        if (nishar < koteret + mafteakh.size() || string(pos, koteret) != to_string(mafteakh.size()) + '\n' ||
+            memcmp(pos + koteret, mafteakh.data(), mafteakh.size()) != 0) {
+            munmap(mapped, st.st_size);
+            count(false);
+            return false;
+        }
+        pos += koteret + mafteakh.size();
+        nishar -= koteret + mafteakh.size();
+        while (nishar > 0) {
+            ssize_t nikhtav = write(STDOUT_FILENO, pos, nishar);
+            if (nikhtav < 0 && errno == EINTR) {
+                continue;
+            }
+            if (nikhtav <= 0) {
+                break;
+            }
+            pos += nikhtav;
+            nishar -= nikhtav;
+        }
+        int shgia = errno;
+        munmap(mapped, st.st_size);
+        if (nishar > 0) {
+            // Part of the IR may be out already, so compiling again would not give a whole module either
+            throw runtime_error(string("cannot write the cached IR: ") + strerror(shgia));
+        }
+
+        // Refresh the mtime, which is the LRU order
+        utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+        count(true);
+        return true;
+    }
+
+    void CompileCache::store(const string &ir) {
+        if (astcache::writeAtomically(path, to_string(mafteakh.size()) + '\n' + mafteakh + ir)) {
+            evict();
+        }
+    }
+
+    void CompileCache::evict() {
+        vector<Knisa> all = knisot(dir);
+        unsigned long long sakh = 0;
+        for (const Knisa &knisa: all) {
+            sakh += knisa.godel;
+        }
+        if (sakh <= godelMaksimali) {
+            return;
+        }
+        sort(all.begin(), all.end(), [](const Knisa &a, const Knisa &b) {
+            if (a.shimushAharon.tv_sec != b.shimushAharon.tv_sec) {
+                return a.shimushAharon.tv_sec < b.shimushAharon.tv_sec;
+            }
+            return a.shimushAharon.tv_nsec < b.shimushAharon.tv_nsec;
+        });
+        // Evict down to 90% of the bound, so that not every following store has to scan the directory again
+        for (const Knisa &knisa: all) {
+            if (sakh <= godelMaksimali / 10 * 9) {
+                break;
+            }
+            if (knisa.path != path && remove(knisa.path.c_str()) == 0) {
+                sakh -= knisa.godel;
+            }
+        }
+    }
+
+    void CompileCache::count(bool hit) {
+        int fd = open((dir + "/stats").c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            return;
+        }
+        flock(fd, LOCK_EX);
+        unsigned long long monim[2] = {0, 0};
+        char text[64] = {0};
+        if (read(fd, text, sizeof(text) - 1) > 0) {
+            sscanf(text, "%llu %llu", &monim[0], &monim[1]);
+        }
+        monim[hit ? 0 : 1]++;
+        int orekh = snprintf(text, sizeof(text), "%llu %llu\n", monim[0], monim[1]);
+        if (ftruncate(fd, 0) == 0) {
+            pwrite(fd, text, orekh, 0);
+        }
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+
+    void CompileCache::printStats(ostream &os) const {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        ifstream stats(dir + "/stats");
+        stats >> hits >> misses;
+
+        vector<Knisa> all = knisot(dir);
+        unsigned long long sakh = 0;
+        for (const Knisa &knisa: all) {
+            sakh += knisa.godel;
+        }
+        os << "hits " << hits << std::endl;
+        os << "misses " << misses << std::endl;
+        os << "entries " << all.size() << std::endl;
+        os << "size " << sakh << " / " << godelMaksimali << " bytes" << std::endl;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef COMPILECACHE_HPP
+#define COMPILECACHE_HPP
+
+#include <ostream>
+#include <string>
+
+/* Whole-file compile cache (ccache style)
+ * Maps the hash of the compiler options and the source to the emitted LLVM IR, stored as <dir>/<hash>.ll.
+ * An entry starts with the length of its key (the IR version, the options and the source) on a line and the key
+ * itself, and a lookup compares the whole key, so two sources whose hashes collide never get each other's IR.
+ * Entries are written atomically, the directory is kept under a size bound by evicting the least recently used
+ * entries (a hit refreshes the entry's mtime) and hit/miss counters are kept in <dir>/stats.
+ */
+namespace compilecache {
+
+    class CompileCache {
+    private:
+        std::string dir;
+        unsigned long long godelMaksimali;
+        // The key and the entry of the last lookup
+        std::string mafteakh;
+        std::string path;
+
+        // Adds one to the hit or miss counter in the stats file, under a file lock
+        void count(bool hit);
+
+        void evict();
+
+    public:
+        // godelMaksimali is the size bound of all the entries together, in bytes
+        CompileCache(const std::string &dir, unsigned long long godelMaksimali);
+
+        // Looks up the entry of the given options and source. On a hit the cached IR is streamed to stdout
+        // straight from a mapping of the entry and true is returned. Throws runtime_error when stdout takes only part
+        // of it
+        bool lookup(const std::string &options, const std::string &makor);
+
+        // Stores the IR compiled on the last lookup's miss
+        void store(const std::string &ir);
+
+        // Prints the counters and the current size of the cache
+        void printStats(std::ostream &os) const;
+    };
+}
+
+#endif //COMPILECACHE_HPP
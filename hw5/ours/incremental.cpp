@@ -0,0 +1,138 @@
+#include "incremental.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "astcache.hpp"
+#include "generator.hpp"
+
+namespace incremental {
+
+    // Part of every fingerprint, bump whenever the IR generated for a function changes
+    static const char *GIRSAT_HAMAHDER = "hw5-fn-18";
+
+    // A function printed without the names of its string constants: kod[0], the name of strings[0], kod[1] and so on.
+    // The names are given by the pool of the module the function is emitted into
+    struct Helek {
+        vector<string> kod;
+        vector<string> strings;
+    };
+
+    static Helek generate(ast::FuncDecl &func) {
+        output::CodeBuffer buffer;
+        LLVM_code_generator generator(buffer);
+        func.accept(generator);
+        Helek helek;
+        ir::print(*generator.releaseFunction(), buffer, [&](const string &str) {
+            helek.kod.push_back(buffer.releaseCode().str());
+            helek.strings.push_back(str);
+        });
+        helek.kod.push_back(buffer.releaseCode().str());
+        return helek;
+    }
+
+    static string fingerprint(ast::FuncDecl &func, const map<string, ast::FuncDecl *> &funcs) {
+        vector<string> callees;
+        string tokhen = GIRSAT_HAMAHDER;
+        tokhen += '\0';
+        tokhen += astcache::serialize(func, false, &callees);
+
+        // The code of a call depends on the callee's signature, so a changed signature regenerates its callers
+        sort(callees.begin(), callees.end());
+        callees.erase(unique(callees.begin(), callees.end()), callees.end());
+        for (const string &callee: callees) {
+            auto nimtsa = funcs.find(callee);
+            if (nimtsa == funcs.end()) {
+                continue;
+            }
+            tokhen += '\0' + callee + '\0';
+            tokhen += astcache::serialize(*nimtsa->second->return_type, false);
+            tokhen += astcache::serialize(*nimtsa->second->formals, false);
+        }
+
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", astcache::hashMakor(tokhen));
+        return hex;
+    }
+
+    // The cache file holds the number of strings and the lengths of all the pieces, in order, on the first line, then
+    // the pieces. An entry whose size does not match its lengths was cut short and is generated again
+    static bool load(const string &path, Helek &helek) {
+        std::ifstream file(path, std::ios::binary);
+        size_t mispar;
+        if (!(file >> mispar)) {
+            return false;
+        }
+        vector<size_t> orakhim;
+        size_t sakh = 0;
+        for (size_t i = 0; i < 2 * mispar + 1; i++) {
+            size_t orekh;
+            if (!(file >> orekh)) {
+                return false;
+            }
+            orakhim.push_back(orekh);
+            sakh += orekh;
+        }
+        if (file.get() != '\n') {
+            return false;
+        }
+        string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (content.size() != sakh) {
+            return false;
+        }
+        size_t pos = 0;
+        for (size_t i = 0; i < orakhim.size(); i++) {
+            (i % 2 ? helek.strings : helek.kod).push_back(content.substr(pos, orakhim[i]));
+            pos += orakhim[i];
+        }
+        return true;
+    }
+
+    static string save(const Helek &helek) {
+        string koteret = std::to_string(helek.strings.size());
+        string content;
+        for (size_t i = 0; i < helek.kod.size(); i++) {
+            if (i > 0) {
+                koteret += " " + std::to_string(helek.strings[i - 1].size());
+                content += helek.strings[i - 1];
+            }
+            koteret += " " + std::to_string(helek.kod[i].size());
+            content += helek.kod[i];
+        }
+        return koteret + "\n" + content;
+    }
+
+    int compile(ast::Funcs &program, const string &dir, std::ostream &os) {
+        map<string, ast::FuncDecl *> funcs;
+        for (auto &func: program.funcs) {
+            funcs[func->id->value] = func.get();
+        }
+
+        output::CodeBuffer module;
+        LLVM_code_generator(module).globalFunctions();
+        output::StringPool pool(module);
+
+        int nivnu = 0;
+        for (auto &func: program.funcs) {
+            string path = dir + "/" + fingerprint(*func, funcs) + ".fn";
+            Helek helek;
+            if (!load(path, helek)) {
+                helek = generate(*func);
+                astcache::writeAtomically(path, save(helek));
+                nivnu++;
+            }
+            for (size_t i = 0; i < helek.kod.size(); i++) {
+                if (i > 0) {
+                    module << pool.intern(helek.strings[i - 1]);
+                }
+                module << helek.kod[i];
+            }
+        }
+
+        // Same layout as the other builds: the string constants, an empty line, the runtime and the functions
+        os << module;
+        return nivnu;
+    }
+}
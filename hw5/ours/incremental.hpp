@@ -0,0 +1,25 @@
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+
+#include <ostream>
+#include <string>
+#include "nodes.hpp"
+
+/* Function-granular incremental code generation
+ * Every FuncDecl gets a fingerprint over its encoded AST (without lines), the signatures of the functions it calls
+ * and the IR version. The IR of each function is kept in <dir>/<fingerprint>.fn and only functions whose
+ * fingerprint is not there are generated again.
+ * Each function is generated into a fresh CodeBuffer, so its registers and labels do not depend on the other
+ * functions. Its string constants are kept as the strings themselves, between the pieces of its code, and are named
+ * by the module's pool when the function is emitted. The functions are emitted in program order after the runtime
+ * functions (printi, print), and the string constants are printed before them all.
+ * As a function's IR only depends on the function itself, nothing is inlined into it (see inliner.hpp).
+ */
+namespace incremental {
+
+    // Generates the IR of a checked program into os, reusing the functions cached in dir.
+    // Returns the number of functions that had to be generated
+    int compile(ast::Funcs &program, const std::string &dir, std::ostream &os);
+}
+
+#endif //INCREMENTAL_HPP
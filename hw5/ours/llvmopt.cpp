@@ -0,0 +1,72 @@
+#include "llvmopt.hpp"
+#include <stdexcept>
+
+#ifdef HW5_LLVM
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#endif
+
+namespace llvmopt {
+
+#ifdef HW5_LLVM
+    bool available() {
+        return true;
+    }
+
+    std::string optimize(const std::string &module, int level) {
+        // A context of its own per call, so sessions on different threads never share LLVM state
+        llvm::LLVMContext context;
+        llvm::SMDiagnostic error;
+        std::unique_ptr<llvm::Module> mudul = llvm::parseAssemblyString(module, error, context);
+        if (!mudul) {
+            throw std::runtime_error("LLVM rejected the module: line " + std::to_string(error.getLineNo()) + ": " +
+                                     error.getMessage().str());
+        }
+        std::string problem;
+        llvm::raw_string_ostream errors(problem);
+        if (llvm::verifyModule(*mudul, &errors)) {
+            throw std::runtime_error("LLVM rejected the module: " + errors.str());
+        }
+
+        llvm::LoopAnalysisManager lam;
+        llvm::FunctionAnalysisManager fam;
+        llvm::CGSCCAnalysisManager cgam;
+        llvm::ModuleAnalysisManager mam;
+        llvm::PassBuilder builder;
+        builder.registerModuleAnalyses(mam);
+        builder.registerCGSCCAnalyses(cgam);
+        builder.registerFunctionAnalyses(fam);
+        builder.registerLoopAnalyses(lam);
+        builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+        static const llvm::OptimizationLevel *const ramot[] = {&llvm::OptimizationLevel::O0,
+                                                               &llvm::OptimizationLevel::O1,
+                                                               &llvm::OptimizationLevel::O2,
+                                                               &llvm::OptimizationLevel::O3};
+        const llvm::OptimizationLevel &rama = *ramot[level < 0 ? 0 : level > 3 ? 3 : level];
+        llvm::ModulePassManager passes = rama == llvm::OptimizationLevel::O0
+                                         ? builder.buildO0DefaultPipeline(rama)
+                                         : builder.buildPerModuleDefaultPipeline(rama);
+        passes.run(*mudul, mam);
+
+        std::string result;
+        llvm::raw_string_ostream os(result);
+        mudul->print(os, nullptr);
+        os.flush();
+        return result;
+    }
+#else
+    bool available() {
+        return false;
+    }
+
+    std::string optimize(const std::string &, int) {
+        throw std::runtime_error("-O needs a build linked against LLVM, see the Makefile");
+    }
+#endif
+}
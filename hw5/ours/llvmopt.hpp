@@ -0,0 +1,20 @@
+#ifndef LLVMOPT_HPP
+#define LLVMOPT_HPP
+
+#include <string>
+
+/* In-process LLVM optimization (-O0 to -O3)
+ * Parses the emitted module with LLVM's own parser, runs the default PassBuilder pipeline of the level on it and
+ * prints it back. Only available when hw5 is built with HW5_LLVM and linked against libLLVM (see the Makefile);
+ * otherwise optimize throws.
+ */
+namespace llvmopt {
+
+    // Whether this build can run the pipeline
+    bool available();
+
+    // Returns the optimized module. Throws std::runtime_error if LLVM rejects the module
+    std::string optimize(const std::string &module, int level);
+}
+
+#endif //LLVMOPT_HPP
@@ -1,20 +1,214 @@
-#include <iostream>
-#include "nodes.hpp"
-#include "output.hpp"
-
-// Extern from the bison-generated parser
-extern int yyparse();
-
-extern std::shared_ptr<ast::Node> program;
-
-int main() {
-    try {
-        yyparse(); // Call the parser function
-        output::ScopePrinter scopePrinter;
-        program->accept(scopePrinter);
-    } catch (const std::exception &e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return 1;
-    }
-    return 0;
-}
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "session.hpp"
+#include "compilecache.hpp"
+#include "llvmopt.hpp"
+#include "server.hpp"
+
+static std::string readAll(std::istream &is) {
+    return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+}
+
+// Compiles the source in a session of its own and returns what it printed, or the message of an error that is not a
+// compilation error, which would end the thread otherwise
+static std::string compileAlone(const SessionOptions &options, const std::string &makor) {
+    std::ostringstream os;
+    try {
+        CompilerSession(options).compile(makor, os);
+    } catch (const std::exception &e) {
+        os << "Error: " << e.what() << std::endl;
+    }
+    return os.str();
+}
+
+// Compiles every file once as a reference, then compiles all of them again and again from several threads at once,
+// each compilation in a session of its own. Every output has to be identical to the reference
+static int stressTest(const SessionOptions &options, int threads, int rounds, const std::vector<std::string> &files) {
+    std::vector<std::string> mekorot;
+    std::vector<std::string> tsfuyim;
+    for (const std::string &file: files) {
+        std::ifstream is(file);
+        mekorot.push_back(readAll(is));
+        tsfuyim.push_back(compileAlone(options, mekorot.back()));
+    }
+
+    std::atomic<int> shgiot(0);
+    std::vector<std::thread> hutim;
+    for (int t = 0; t < threads; t++) {
+        hutim.emplace_back([&, t]() {
+            for (int round = 0; round < rounds; round++) {
+                for (size_t i = 0; i < mekorot.size(); i++) {
+                    // Every thread starts at a different file, so different sources are compiled at the same time
+                    size_t haIndeks = (i + t) % mekorot.size();
+                    if (compileAlone(options, mekorot[haIndeks]) != tsfuyim[haIndeks]) {
+                        shgiot++;
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread &hut: hutim) {
+        hut.join();
+    }
+    std::cout << "stress: " << threads * rounds * mekorot.size() << " compilations on " << threads << " threads, "
+              << shgiot << " mismatches" << std::endl;
+    return shgiot == 0 ? 0 : 1;
+}
+
+// Usage: hw5 [--rd] [-O0|-O1|-O2|-O3] [--no-inline] [--pass-report] [--parse-only] [--check-only]
+//          [--check-threads N] [--gen-threads N] [--ast-cache dir] [--cache dir [--cache-size MB] [--cache-stats]]
+//          [--incremental dir] [--stress threads rounds file...]
+//          [--serve socket [--workers N]] [--connect socket] [--latency socket runs file...]
+//      --rd                parse with the hand-written recursive descent parser instead of bison
+//      -O0 ... -O3         run LLVM's default pipeline of the level on the module before printing, see llvmopt.hpp
+//      --no-inline         do not inline small functions into their callers (used to benchmark it), see inliner.hpp
+//      --pass-report       print the number of instructions after every IR pass to stderr, see generator.cpp
+//      --parse-only        stop after building the AST (used to benchmark the parsers)
+//      --check-only        stop after the semantic analysis (used to benchmark it)
+//      --check-threads N   check the function bodies on N threads, the output does not depend on N
+//      --gen-threads N     generate the functions on N threads, the output does not depend on N, see parallelgen.hpp
+//      --ast-cache dir     reuse the checked AST of an identical source from dir, see astcache.hpp
+//      --cache dir         reuse the whole output of an identical source and options from dir, see compilecache.hpp
+//      --cache-size MB     size bound of the compile cache, 256 MB by default
+//      --cache-stats       print the hit/miss statistics of the compile cache and exit
+//      --incremental dir   only generate the functions that changed since their IR was kept in dir, see incremental.hpp
+//      --stress ...        compile the files concurrently in many sessions and check the outputs, see stressTest
+//      --serve socket      run as a compile server on the Unix socket, see server.hpp
+//      --workers N         number of worker threads of the server, one per core by default
+//      --connect socket    compile stdin on the server instead of in this process
+//      --latency ...       compare the latency of the server with starting this compiler for every file
+int main(int argc, char *argv[]) {
+    SessionOptions options;
+    bool cacheStats = false;
+    const char *cacheDir = nullptr;
+    unsigned long long cacheSize = 256;
+    int stressThreads = 0;
+    int stressRounds = 0;
+    std::vector<std::string> stressFiles;
+    const char *serveSocket = nullptr;
+    const char *connectSocket = nullptr;
+    int workers = std::max(1u, std::thread::hardware_concurrency());
+    int latencyRuns = 0;
+    // The command line the latency benchmark starts for every file, with the options of the server
+    std::vector<std::string> self = {"/proc/self/exe"};
+    // Every option that can change the output, part of the compile cache key
+    std::string key;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ast-cache") == 0 && i + 1 < argc) {
+            options.astCacheDir = argv[++i];
+            self.insert(self.end(), {"--ast-cache", options.astCacheDir});
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cacheDir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+            cacheSize = std::strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--incremental") == 0 && i + 1 < argc) {
+            options.incrementalDir = argv[++i];
+            key += "--incremental ";
+            self.insert(self.end(), {"--incremental", options.incrementalDir});
+        } else if (strcmp(argv[i], "--check-threads") == 0 && i + 1 < argc) {
+            options.checkThreads = std::max(1, std::atoi(argv[++i]));
+            self.insert(self.end(), {"--check-threads", argv[i]});
+        } else if (strcmp(argv[i], "--gen-threads") == 0 && i + 1 < argc) {
+            options.genThreads = std::max(1, std::atoi(argv[++i]));
+            self.insert(self.end(), {"--gen-threads", argv[i]});
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            cacheStats = true;
+        } else if (strcmp(argv[i], "--stress") == 0 && i + 2 < argc) {
+            stressThreads = std::atoi(argv[++i]);
+            stressRounds = std::atoi(argv[++i]);
+            while (i + 1 < argc) {
+                stressFiles.push_back(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveSocket = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = std::max(1, std::atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            connectSocket = argv[++i];
+        } else if (strcmp(argv[i], "--latency") == 0 && i + 2 < argc) {
+            connectSocket = argv[++i];
+            latencyRuns = std::atoi(argv[++i]);
+            while (i + 1 < argc) {
+                stressFiles.push_back(argv[++i]);
+            }
+        } else {
+            if (strcmp(argv[i], "--rd") == 0) {
+                options.rd = true;
+            } else if (strcmp(argv[i], "--no-inline") == 0) {
+                options.inlining = false;
+            } else if (strcmp(argv[i], "--pass-report") == 0) {
+                options.passReport = true;
+            } else if (strcmp(argv[i], "--parse-only") == 0) {
+                options.parseOnly = true;
+            } else if (strcmp(argv[i], "--check-only") == 0) {
+                options.checkOnly = true;
+            } else if (argv[i][0] == '-' && argv[i][1] == 'O' && argv[i][2] >= '0' && argv[i][2] <= '3' &&
+                       argv[i][3] == '\0') {
+                if (!llvmopt::available()) {
+                    std::cerr << "Error: " << argv[i] << " needs a build linked against LLVM" << std::endl;
+                    return 1;
+                }
+                options.optLevel = argv[i][2] - '0';
+            }
+            key += argv[i];
+            key += ' ';
+            self.push_back(argv[i]);
+        }
+    }
+
+    compilecache::CompileCache compileCache(cacheDir ? cacheDir : "", cacheSize << 20);
+    if (cacheStats) {
+        compileCache.printStats(std::cout);
+        return 0;
+    }
+
+    try {
+        if (stressThreads > 0) {
+            return stressTest(options, stressThreads, stressRounds, stressFiles);
+        }
+        if (serveSocket) {
+            server::serve(serveSocket, options, workers);
+            return 0;
+        }
+        if (latencyRuns > 0) {
+            server::latencyBenchmark(connectSocket, latencyRuns, stressFiles, self);
+            return 0;
+        }
+
+        std::string makor = readAll(std::cin);
+        if (connectSocket) {
+            int status;
+            std::string teshuva = server::request(connectSocket, makor, &status);
+            (status == 0 ? std::cout : std::cerr) << teshuva;
+            return status;
+        }
+        if (cacheDir && !options.parseOnly && !options.checkOnly && compileCache.lookup(key, makor)) {
+            return 0;
+        }
+        CompilerSession session(options);
+        if (cacheDir) {
+            // The IR is kept in memory, so that it can be stored after printing
+            std::ostringstream ir;
+            bool hatslaha = session.compile(makor, ir);
+            std::cout << ir.str();
+            if (hatslaha) {
+                compileCache.store(ir.str());
+            }
+        } else {
+            session.compile(makor, STDOUT_FILENO);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -2,13 +2,13 @@
 #include <string>
 #include <utility>
 
-extern int yylineno;
-
 namespace ast {
 
+    thread_local int shuraNokhehit = 1;
+
     Exp::Exp(BuiltInType B) : type(B) {}
 
-    Node::Node() : line(yylineno) {}
+    Node::Node() : line(shuraNokhehit) {}
 
     Num::Num(const char *str) : Exp(), value(std::stoi(str)) {}
 
@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include "visitor.hpp"
+#include "ir.hpp"
 
 namespace ast {
 
@@ -36,6 +37,10 @@ namespace ast {
         NOTHING
     };
 
+    // Line the scanner running on this thread is at. Set by the scanner on every match and read by Node(),
+    // so compilations on different threads do not share it
+    extern thread_local int shuraNokhehit;
+
     /* Base class for all AST nodes */
     class Node {
     public:
@@ -53,7 +58,8 @@ namespace ast {
     class Exp : virtual public Node {
     public:
         int erekhMispar;
-        std::string erekhBituy;
+        // Register or constant holding the value, set by the code generator
+        ir::Value erekhBituy;
         BuiltInType type = NOTHING;
         Exp(BuiltInType B);
         Exp() = default;
@@ -0,0 +1,90 @@
+#include "parallelgen.hpp"
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include "astcache.hpp"
+#include "generator.hpp"
+
+namespace parallelgen {
+
+    struct Shard {
+        // The function after its passes, printed when the shard is committed
+        std::shared_ptr<ir::Function> function;
+        bool muchan = false;
+    };
+
+    static std::shared_ptr<ir::Function> generate(ast::FuncDecl &func, ir::InlineLibrary *library,
+                                                  ir::PassReport *report) {
+        output::CodeBuffer buffer;
+        LLVM_code_generator generator(buffer, library, report);
+        func.accept(generator);
+        std::shared_ptr<ir::Function> function = generator.releaseFunction();
+        generator.optimize(function);
+        return function;
+    }
+
+    void compile(ast::Funcs &program, int hutim, const Sink &sink, bool inlining, ir::PassReport *report) {
+        vector<string> shemot;
+        vector<vector<string>> nikraim(program.funcs.size());
+        for (size_t i = 0; i < program.funcs.size(); i++) {
+            shemot.push_back(program.funcs[i]->id->value);
+            if (inlining) {
+                astcache::serialize(*program.funcs[i], false, &nikraim[i]);
+            }
+        }
+        ir::InlineLibrary library(shemot, nikraim);
+        // Without inlining no function waits for another, and they are generated in program order
+        vector<size_t> seder = library.order();
+        if (!inlining) {
+            std::iota(seder.begin(), seder.end(), 0);
+        }
+
+        output::CodeBuffer module;
+        LLVM_code_generator(module).globalFunctions();
+        output::StringPool pool(module);
+        output::Rope builtins = module.releaseCode();
+        sink(builtins);
+
+        vector<Shard> shards(program.funcs.size());
+        // The next task, an index into seder
+        std::atomic<size_t> haba(0);
+        // Shards before this one are committed; guarded by mutexCommit together with the module, the pool and the sink
+        size_t haBaLeCommit = 0;
+        std::mutex mutexCommit;
+
+        auto oved = [&]() {
+            size_t mesima;
+            while ((mesima = haba++) < shards.size()) {
+                size_t makom = seder[mesima];
+                std::shared_ptr<ir::Function> function =
+                        generate(*program.funcs[makom], inlining ? &library : nullptr, report);
+                std::lock_guard<std::mutex> lock(mutexCommit);
+                shards[makom].function = std::move(function);
+                shards[makom].muchan = true;
+                // The thread that completes the prefix commits it, later shards wait for the earlier ones
+                while (haBaLeCommit < shards.size() && shards[haBaLeCommit].muchan) {
+                    Shard &committed = shards[haBaLeCommit++];
+                    ir::print(*committed.function, module, pool);
+                    output::Rope code = module.releaseCode();
+                    sink(code);
+                    committed = Shard();
+                }
+            }
+        };
+
+        vector<std::thread> hutimPailim;
+        for (int hut = 1; hut < hutim && hut < (int) shards.size(); hut++) {
+            hutimPailim.emplace_back(oved);
+        }
+        oved(); // The calling thread is one of the workers
+        for (std::thread &hut: hutimPailim) {
+            hut.join();
+        }
+
+        // The string constants, followed by an empty line like the globals of a single CodeBuffer
+        output::Rope globals = module.release();
+        sink(globals);
+    }
+}
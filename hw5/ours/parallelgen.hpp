@@ -0,0 +1,35 @@
+#ifndef PARALLELGEN_HPP
+#define PARALLELGEN_HPP
+
+#include <functional>
+#include "nodes.hpp"
+#include "output.hpp"
+
+namespace ir {
+    class PassReport;
+}
+
+/* Parallel code generation
+ * Every function is lowered and optimized by a generator of its own into an IR function of its own (a shard), so
+ * registers and labels are numbered per function and the functions can be generated on several threads. Shards are
+ * committed in source order as soon as they and every shard before them are done: the committed function is printed
+ * into the module, its string constants named by one deduplicating pool, so the module is the same for any number of
+ * threads.
+ * A committed shard is handed to the output and freed right away, so only the functions still waiting for an earlier
+ * one are held in memory. The string constants are written after all the functions, LLVM IR allows a global to be
+ * defined after its uses.
+ * The generators share one inline library (see inliner.hpp). With inlining the functions are generated in the
+ * library's order, callees first, the call graph taken from their ASTs; they are still committed in source order, and
+ * a function only inlines the functions of earlier components, so inlining does not change the module either.
+ */
+namespace parallelgen {
+
+    // Receives the module piece by piece, in order
+    typedef std::function<void(output::Rope &)> Sink;
+
+    // Generates the module of the checked program on hutim threads and hands it to the sink. The passes are counted
+    // into the report unless it is nullptr
+    void compile(ast::Funcs &program, int hutim, const Sink &sink, bool inlining, ir::PassReport *report = nullptr);
+}
+
+#endif //PARALLELGEN_HPP
@@ -5,21 +5,30 @@
 #include <string>
 //#include "token.hpp"
 
-// bison declarations
-extern int yylineno;
-extern int yylex();
-void yyerror(const char*);
-
-
-
 using namespace std;
 using namespace ast;
 using namespace output;
-
-// root of the AST, set by the parser and used by other parts of the compiler
-shared_ptr<Node> program; 
 %}
 
+// The parser and the scanner keep no global state, so several compilations can run at once.
+// The root of the AST is returned through the program parameter.
+%code requires {
+#include <memory>
+#include "nodes.hpp"
+typedef void *yyscan_t;
+}
+
+%code {
+// bison declarations
+int yylex(YYSTYPE *yylval, yyscan_t scanner);
+int yyget_lineno(yyscan_t scanner);
+void yyerror(yyscan_t scanner, shared_ptr<ast::Node> &program, const char*);
+}
+
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {std::shared_ptr<ast::Node> &program}
+
 // Define tokens here
 %token VOID
 %token INT
@@ -77,9 +86,9 @@ shared_ptr<Node> program;
 Program:  Funcs { program = $1; }
 ;
 
-// Grammar for functions
+// Grammar for functions (left recursive, so the parser stack does not grow with the number of functions)
 Funcs:      { $$ = make_shared<Funcs>(); } 
-        | FuncDecl Funcs {  $$ = $2; dynamic_pointer_cast<ast::Funcs>($$)->push_front(dynamic_pointer_cast<ast::FuncDecl>($1)); }
+        | Funcs FuncDecl {  $$ = $1; dynamic_pointer_cast<ast::Funcs>($$)->push_back(dynamic_pointer_cast<ast::FuncDecl>($2)); }
 ;
 
 // Function declarations
@@ -172,6 +181,6 @@ Exp: LPAREN Exp RPAREN { $$ = $2; }
 %%
 
 // Error reporting
-void yyerror(const char* message) {
-    errorSyn(yylineno); 
+void yyerror(yyscan_t scanner, shared_ptr<ast::Node> &program, const char* message) {
+    errorSyn(yyget_lineno(scanner)); 
 }
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "rdparser.hpp"
+#include "output.hpp"
+#include "parser.tab.h"
+
+int yylex(YYSTYPE *yylval, yyscan_t scanner);
+int yyget_lineno(yyscan_t scanner);
+
+using namespace std;
+
+namespace {
+
+    // Binding power of every binary operator, 0 for tokens that are not binary operators.
+    // Mirrors the %left declarations of parser.y; NOT and casts bind tighter than all of them.
+    int precedence(int token) {
+        switch (token) {
+            case OR:
+                return 1;
+            case AND:
+                return 2;
+            case R_EQ:
+            case R_NE:
+                return 3;
+            case R_LT:
+            case R_GT:
+            case R_LE:
+            case R_GE:
+                return 4;
+            case B_ADD:
+            case B_SUB:
+                return 5;
+            case B_MUL:
+            case B_DIV:
+                return 6;
+            default:
+                return 0;
+        }
+    }
+
+    bool zeTippus(int token) {
+        return token == INT || token == BYTE || token == BOOL;
+    }
+
+    shared_ptr<ast::Exp> binary(int token, shared_ptr<ast::Exp> left, shared_ptr<ast::Exp> right) {
+        switch (token) {
+            case OR:
+                return make_shared<ast::Or>(left, right);
+            case AND:
+                return make_shared<ast::And>(left, right);
+            case R_EQ:
+                return make_shared<ast::RelOp>(left, right, ast::RelOpType::EQ);
+            case R_NE:
+                return make_shared<ast::RelOp>(left, right, ast::RelOpType::NE);
+            case R_LT:
+                return make_shared<ast::RelOp>(left, right, ast::RelOpType::LT);
+            case R_GT:
+                return make_shared<ast::RelOp>(left, right, ast::RelOpType::GT);
+            case R_LE:
+                return make_shared<ast::RelOp>(left, right, ast::RelOpType::LE);
+            case R_GE:
+                return make_shared<ast::RelOp>(left, right, ast::RelOpType::GE);
+            case B_ADD:
+                return make_shared<ast::BinOp>(left, right, ast::BinOpType::ADD);
+            case B_SUB:
+                return make_shared<ast::BinOp>(left, right, ast::BinOpType::SUB);
+            case B_MUL:
+                return make_shared<ast::BinOp>(left, right, ast::BinOpType::MUL);
+            default:
+                return make_shared<ast::BinOp>(left, right, ast::BinOpType::DIV);
+        }
+    }
+}
+
+RecursiveDescentParser::RecursiveDescentParser(yyscan_t scanner) : scanner(scanner), lookahead(0), yeshLookahead(false) {}
+
+int RecursiveDescentParser::peek() {
+    if (!yeshLookahead) {
+        lookahead = yylex(&erekhLookahead, scanner);
+        yeshLookahead = true;
+    }
+    return lookahead;
+}
+
+shared_ptr<ast::Node> RecursiveDescentParser::expect(int token) {
+    if (peek() != token) {
+        syntaxError();
+    }
+    yeshLookahead = false;
+    return erekhLookahead;
+}
+
+void RecursiveDescentParser::syntaxError() {
+    output::errorSyn(yyget_lineno(scanner));
+}
+
+shared_ptr<ast::Funcs> RecursiveDescentParser::parseProgram() {
+    vector<shared_ptr<ast::FuncDecl>> funcs;
+    while (peek() != 0) {
+        funcs.push_back(parseFuncDecl());
+    }
+    shared_ptr<ast::Funcs> program = make_shared<ast::Funcs>();
+    program->funcs = std::move(funcs);
+    return program;
+}
+
+shared_ptr<ast::FuncDecl> RecursiveDescentParser::parseFuncDecl() {
+    shared_ptr<ast::Type> returnType;
+    if (peek() == VOID) {
+        expect(VOID);
+        returnType = make_shared<ast::Type>(ast::BuiltInType::VOID);
+    } else {
+        returnType = parseType();
+    }
+    shared_ptr<ast::ID> id = dynamic_pointer_cast<ast::ID>(expect(ID));
+    expect(LPAREN);
+    shared_ptr<ast::Formals> formals = parseFormals();
+    expect(RPAREN);
+    expect(LBRACE);
+    shared_ptr<ast::Statements> body = parseStatements();
+    expect(RBRACE);
+    return make_shared<ast::FuncDecl>(id, returnType, formals, body);
+}
+
+shared_ptr<ast::Type> RecursiveDescentParser::parseType() {
+    switch (peek()) {
+        case INT:
+            expect(INT);
+            return make_shared<ast::Type>(ast::BuiltInType::INT);
+        case BYTE:
+            expect(BYTE);
+            return make_shared<ast::Type>(ast::BuiltInType::BYTE);
+        case BOOL:
+            expect(BOOL);
+            return make_shared<ast::Type>(ast::BuiltInType::BOOL);
+        default:
+            syntaxError();
+            return nullptr;
+    }
+}
+
+shared_ptr<ast::Formals> RecursiveDescentParser::parseFormals() {
+    if (peek() == RPAREN) {
+        return make_shared<ast::Formals>();
+    }
+    shared_ptr<ast::Formals> formals = make_shared<ast::Formals>();
+    while (true) {
+        shared_ptr<ast::Type> type = parseType();
+        shared_ptr<ast::ID> id = dynamic_pointer_cast<ast::ID>(expect(ID));
+        formals->push_back(make_shared<ast::Formal>(id, type));
+        if (peek() != COMMA) {
+            return formals;
+        }
+        expect(COMMA);
+    }
+}
+
+shared_ptr<ast::Statements> RecursiveDescentParser::parseStatements() {
+    shared_ptr<ast::Statements> statements = make_shared<ast::Statements>(parseStatement());
+    while (peek() != RBRACE) {
+        statements->push_back(parseStatement());
+    }
+    return statements;
+}
+
+shared_ptr<ast::Statement> RecursiveDescentParser::parseStatement() {
+    int token = peek();
+    if (zeTippus(token)) {
+        shared_ptr<ast::Type> type = parseType();
+        shared_ptr<ast::ID> id = dynamic_pointer_cast<ast::ID>(expect(ID));
+        if (peek() == SC) {
+            expect(SC);
+            return make_shared<ast::VarDecl>(id, type);
+        }
+        expect(ASSIGN);
+        shared_ptr<ast::Exp> initExp = parseExp();
+        expect(SC);
+        return make_shared<ast::VarDecl>(id, type, initExp);
+    }
+
+    switch (token) {
+        case LBRACE: {
+            expect(LBRACE);
+            shared_ptr<ast::Statements> block = parseStatements();
+            expect(RBRACE);
+            block->zeSograyim = true;
+            return block;
+        }
+        case ID: {
+            shared_ptr<ast::ID> id = dynamic_pointer_cast<ast::ID>(expect(ID));
+            if (peek() == ASSIGN) {
+                expect(ASSIGN);
+                shared_ptr<ast::Exp> exp = parseExp();
+                expect(SC);
+                return make_shared<ast::Assign>(id, exp);
+            }
+            shared_ptr<ast::Call> call = parseCall(id);
+            expect(SC);
+            return call;
+        }
+        case RETURN: {
+            expect(RETURN);
+            if (peek() == SC) {
+                expect(SC);
+                return make_shared<ast::Return>();
+            }
+            shared_ptr<ast::Exp> exp = parseExp();
+            expect(SC);
+            return make_shared<ast::Return>(exp);
+        }
+        case IF: {
+            expect(IF);
+            expect(LPAREN);
+            shared_ptr<ast::Exp> condition = parseExp();
+            expect(RPAREN);
+            shared_ptr<ast::Statement> then = parseStatement();
+            // A dangling else belongs to the nearest if, like the shift chosen by bison
+            if (peek() != ELSE) {
+                return make_shared<ast::If>(condition, then);
+            }
+            expect(ELSE);
+            shared_ptr<ast::Statement> otherwise = parseStatement();
+            return make_shared<ast::If>(condition, then, otherwise);
+        }
+        case WHILE: {
+            expect(WHILE);
+            expect(LPAREN);
+            shared_ptr<ast::Exp> condition = parseExp();
+            expect(RPAREN);
+            shared_ptr<ast::Statement> body = parseStatement();
+            return make_shared<ast::While>(condition, body);
+        }
+        case BREAK:
+            expect(BREAK);
+            expect(SC);
+            return make_shared<ast::Break>();
+        case CONTINUE:
+            expect(CONTINUE);
+            expect(SC);
+            return make_shared<ast::Continue>();
+        default:
+            syntaxError();
+            return nullptr;
+    }
+}
+
+shared_ptr<ast::Call> RecursiveDescentParser::parseCall(shared_ptr<ast::ID> id) {
+    expect(LPAREN);
+    if (peek() == RPAREN) {
+        expect(RPAREN);
+        return make_shared<ast::Call>(id);
+    }
+    shared_ptr<ast::ExpList> args = make_shared<ast::ExpList>(parseExp());
+    while (peek() == COMMA) {
+        expect(COMMA);
+        args->push_back(parseExp());
+    }
+    expect(RPAREN);
+    return make_shared<ast::Call>(id, args);
+}
+
+shared_ptr<ast::Exp> RecursiveDescentParser::parseExp(int minPrecedence) {
+    shared_ptr<ast::Exp> left = parseUnary();
+    // All binary operators are left associative, so the right operand only takes tighter operators
+    int token = peek();
+    while (precedence(token) >= minPrecedence && precedence(token) > 0) {
+        expect(token);
+        shared_ptr<ast::Exp> right = parseExp(precedence(token) + 1);
+        left = binary(token, left, right);
+        token = peek();
+    }
+    return left;
+}
+
+shared_ptr<ast::Exp> RecursiveDescentParser::parseUnary() {
+    switch (peek()) {
+        case NOT: {
+            expect(NOT);
+            shared_ptr<ast::Exp> exp = parseUnary();
+            peek();
+            return make_shared<ast::Not>(exp);
+        }
+        case LPAREN: {
+            expect(LPAREN);
+            if (zeTippus(peek())) {
+                shared_ptr<ast::Type> type = parseType();
+                expect(RPAREN);
+                shared_ptr<ast::Exp> exp = parseUnary();
+                peek();
+                return make_shared<ast::Cast>(exp, type);
+            }
+            shared_ptr<ast::Exp> exp = parseExp();
+            expect(RPAREN);
+            return exp;
+        }
+        case ID: {
+            shared_ptr<ast::ID> id = dynamic_pointer_cast<ast::ID>(expect(ID));
+            if (peek() == LPAREN) {
+                return parseCall(id);
+            }
+            return id;
+        }
+        case NUM:
+            return dynamic_pointer_cast<ast::Exp>(expect(NUM));
+        case NUM_B:
+            return dynamic_pointer_cast<ast::Exp>(expect(NUM_B));
+        case STRING:
+            return dynamic_pointer_cast<ast::Exp>(expect(STRING));
+        case TRUE:
+            expect(TRUE);
+            return make_shared<ast::Bool>(true);
+        case FALSE:
+            expect(FALSE);
+            return make_shared<ast::Bool>(false);
+        default:
+            syntaxError();
+            return nullptr;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef RDPARSER_HPP
+#define RDPARSER_HPP
+
+#include <memory>
+#include "nodes.hpp"
+
+typedef void *yyscan_t;
+
+/* Hand-written recursive descent parser, an alternative to the bison parser.
+ * Statements are parsed by recursive descent and expressions by precedence climbing (Pratt),
+ * using the same precedence table as parser.y. It reads tokens from a reentrant scanner through yylex and builds the same ast:: nodes.
+ * Nodes are created after exactly the tokens bison would have read when reducing them,
+ * so line numbers and the order of lexical/syntax errors match the bison parser.
+ */
+class RecursiveDescentParser {
+private:
+    yyscan_t scanner;
+    // The token after the ones already consumed, read lazily so no token is read before bison would read it
+    int lookahead;
+    bool yeshLookahead;
+    std::shared_ptr<ast::Node> erekhLookahead;
+
+    int peek();
+
+    // Consumes the lookahead token, reporting a syntax error if it is not the expected one
+    std::shared_ptr<ast::Node> expect(int token);
+
+    void syntaxError();
+
+    std::shared_ptr<ast::FuncDecl> parseFuncDecl();
+
+    std::shared_ptr<ast::Type> parseType();
+
+    std::shared_ptr<ast::Formals> parseFormals();
+
+    std::shared_ptr<ast::Statements> parseStatements();
+
+    std::shared_ptr<ast::Statement> parseStatement();
+
+    std::shared_ptr<ast::Call> parseCall(std::shared_ptr<ast::ID> id);
+
+    std::shared_ptr<ast::Exp> parseExp(int minPrecedence = 1);
+
+    std::shared_ptr<ast::Exp> parseUnary();
+
+public:
+    explicit RecursiveDescentParser(yyscan_t scanner);
+
+    // Parses the whole input and returns the root of the AST
+    std::shared_ptr<ast::Funcs> parseProgram();
+};
+
+#endif //RDPARSER_HPP
@@ -0,0 +1,203 @@
+#include "server.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace server {
+
+    static sockaddr_un ktovet(const std::string &path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("socket path too long: " + path);
+        }
+        strcpy(address.sun_path, path.c_str());
+        return address;
+    }
+
+    static std::string readUntilEof(int fd) {
+        std::string data;
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(fd, chunk, sizeof(chunk))) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            data.append(chunk, n);
+        }
+        return data;
+    }
+
+    static bool writeAll(int fd, const std::string &data) {
+        size_t nikhtav = 0;
+        while (nikhtav < data.size()) {
+            ssize_t n = write(fd, data.data() + nikhtav, data.size() - nikhtav);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            nikhtav += n;
+        }
+        return true;
+    }
+
+    // Every worker blocks in accept on the same listening socket, the kernel hands each connection to one of them
+    static void oved(int listener, const SessionOptions &options) {
+        CompilerSession session(options);
+        while (true) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return;
+            }
+            std::string makor = readUntilEof(fd);
+            // Like main, which prints the message and exits with 1, but the session stays usable for the next request
+            std::string status = "0";
+            try {
+                session.compile(makor, fd);
+            } catch (const std::exception &e) {
+                writeAll(fd, "Error: " + std::string(e.what()) + "\n");
+                status = "1";
+            }
+            writeAll(fd, '\0' + status);
+            close(fd);
+        }
+    }
+
+    void serve(const std::string &path, const SessionOptions &options, int ovdim) {
+        // A client that disconnects early must not kill the server
+        signal(SIGPIPE, SIG_IGN);
+        sockaddr_un address = ktovet(path);
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) {
+            throw std::runtime_error("socket: " + std::string(strerror(errno)));
+        }
+        unlink(path.c_str());
+        if (bind(listener, (sockaddr *) &address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+            throw std::runtime_error("cannot listen on " + path + ": " + strerror(errno));
+        }
+
+        std::vector<std::thread> ovdimPailim;
+        for (int i = 0; i < ovdim; i++) {
+            ovdimPailim.emplace_back(oved, listener, std::cref(options));
+        }
+        for (std::thread &hut: ovdimPailim) {
+            hut.join();
+        }
+        close(listener);
+    }
+
+    std::string request(const std::string &path, const std::string &makor, int *status) {
+        sockaddr_un address = ktovet(path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (sockaddr *) &address, sizeof(address)) != 0) {
+            std::string siba = strerror(errno);
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::runtime_error("cannot connect to " + path + ": " + siba);
+        }
+        if (!writeAll(fd, makor)) {
+            close(fd);
+            throw std::runtime_error("cannot send the source to " + path);
+        }
+        shutdown(fd, SHUT_WR);
+        std::string teshuva = readUntilEof(fd);
+        close(fd);
+        size_t sof = teshuva.rfind('\0');
+        if (sof == std::string::npos) {
+            throw std::runtime_error("no answer from " + path);
+        }
+        if (status) {
+            *status = std::atoi(teshuva.c_str() + sof + 1);
+        }
+        teshuva.resize(sof);
+        return teshuva;
+    }
+
+    // Runs the compiler as a new process on the file, like a build system calling the command line compiler
+    static void forkExec(const std::vector<std::string> &self, const std::string &file) {
+        std::vector<char *> argv;
+        for (const std::string &arg: self) {
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, 0, file.c_str(), O_RDONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+        pid_t pid;
+        if (posix_spawn(&pid, argv[0], &actions, nullptr, argv.data(), environ) != 0) {
+            posix_spawn_file_actions_destroy(&actions);
+            throw std::runtime_error("cannot start " + self[0]);
+        }
+        posix_spawn_file_actions_destroy(&actions);
+        int status;
+        waitpid(pid, &status, 0);
+    }
+
+    static void printPercentiles(const char *shem, std::vector<double> &zmanim) {
+        std::sort(zmanim.begin(), zmanim.end());
+        auto percentile = [&](double p) {
+            return zmanim[std::min(zmanim.size() - 1, (size_t) (p * zmanim.size()))];
+        };
+        std::cout << shem << ": p50 " << percentile(0.50) << " us, p99 " << percentile(0.99) << " us" << std::endl;
+    }
+
+    void latencyBenchmark(const std::string &path, int runs, const std::vector<std::string> &files,
+                          const std::vector<std::string> &self) {
+        if (runs <= 0 || files.empty()) {
+            throw std::runtime_error("nothing to benchmark");
+        }
+        std::vector<std::string> mekorot;
+        for (const std::string &file: files) {
+            std::ifstream is(file);
+            std::ostringstream makor;
+            makor << is.rdbuf();
+            mekorot.push_back(makor.str());
+        }
+
+        using clock = std::chrono::steady_clock;
+        auto microseconds = [](clock::duration d) {
+            return std::chrono::duration<double, std::micro>(d).count();
+        };
+        std::vector<double> server;
+        std::vector<double> cli;
+        for (int i = 0; i < runs; i++) {
+            size_t haIndeks = i % files.size();
+            clock::time_point hathala = clock::now();
+            request(path, mekorot[haIndeks]);
+            server.push_back(microseconds(clock::now() - hathala));
+
+            hathala = clock::now();
+            forkExec(self, files[haIndeks]);
+            cli.push_back(microseconds(clock::now() - hathala));
+        }
+        std::cout << runs << " compilations of " << files.size() << " files" << std::endl;
+        printPercentiles("server", server);
+        printPercentiles("fork-exec", cli);
+    }
+}
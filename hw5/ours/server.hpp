@@ -0,0 +1,31 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+#include <vector>
+#include "session.hpp"
+
+/* Compile server (hw5 --serve)
+ * Listens on a Unix-domain socket and compiles every connection on a pool of worker threads. Each worker keeps one
+ * CompilerSession for its whole life, so a request costs only the compilation, not a process start.
+ * Protocol: the client writes the FanC source and shuts down its writing side, the server answers with exactly
+ * what the command line compiler would print (the IR or the error message), a NUL byte and the exit status the
+ * command line compiler would return, and closes the connection. A compilation that fails other than by a
+ * compilation error (status 1) answers with the diagnostic, and the worker goes on serving.
+ */
+namespace server {
+
+    // Serves requests on the socket at path until the process is killed. An old socket file at path is replaced
+    void serve(const std::string &path, const SessionOptions &options, int ovdim);
+
+    // Sends the source to the server at path and returns its answer. The exit status of the compilation is stored
+    // into status unless it is nullptr
+    std::string request(const std::string &path, const std::string &makor, int *status = nullptr);
+
+    // Compiles the files runs times in turn, once through the server and once by starting the compiler at self
+    // with the given arguments, and prints the p50/p99 latency of both
+    void latencyBenchmark(const std::string &path, int runs, const std::vector<std::string> &files,
+                          const std::vector<std::string> &self);
+}
+
+#endif //SERVER_HPP
@@ -0,0 +1,126 @@
+#include "session.hpp"
+#include "astcache.hpp"
+#include "incremental.hpp"
+#include "llvmopt.hpp"
+#include "outputAndSymbolTable.hpp"
+#include "passes.hpp"
+#include "rdparser.hpp"
+#include "parser.tab.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// The reentrant flex scanner
+int yylex_init(yyscan_t *scanner);
+int yylex_destroy(yyscan_t scanner);
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+YY_BUFFER_STATE yy_scan_string(const char *str, yyscan_t scanner);
+
+namespace {
+
+    // A scanner reading from a string; destroyed with its buffer even when a compilation error is thrown
+    class Sorek {
+    private:
+        yyscan_t scanner;
+
+    public:
+        explicit Sorek(const std::string &makor) {
+            yylex_init(&scanner);
+            yy_scan_string(makor.c_str(), scanner);
+            ast::shuraNokhehit = 1;
+        }
+
+        ~Sorek() {
+            yylex_destroy(scanner);
+        }
+
+        yyscan_t get() const {
+            return scanner;
+        }
+    };
+}
+
+CompilerSession::CompilerSession(const SessionOptions &options) : options(options) {}
+
+void CompilerSession::frontEnd(const std::string &makor) {
+    std::string path;
+    if (!options.astCacheDir.empty()) {
+        path = astcache::cachePath(options.astCacheDir, makor);
+        program = astcache::load(path);
+        if (program) {
+            return;
+        }
+    }
+
+    Sorek sorek(makor);
+    if (options.rd) {
+        RecursiveDescentParser parser(sorek.get());
+        program = parser.parseProgram();
+    } else {
+        yyparse(sorek.get(), program); // Call the parser function
+    }
+    if (options.parseOnly) {
+        return;
+    }
+    outputAndSymbolTable::ScopePrinter scopePrinter(options.checkThreads);
+    program->accept(scopePrinter);
+    if (!path.empty()) {
+        astcache::save(path, *std::dynamic_pointer_cast<ast::Funcs>(program));
+    }
+}
+
+bool CompilerSession::compile(const std::string &makor, const parallelgen::Sink &sink) {
+    program = nullptr;
+    try {
+        frontEnd(makor);
+        if (options.parseOnly || options.checkOnly) {
+            return true;
+        }
+        // The LLVM pipeline needs the whole module, so the pieces are collected instead of streamed
+        std::ostringstream module;
+        parallelgen::Sink target = sink;
+        if (options.optLevel >= 0) {
+            target = [&](output::Rope &out) {
+                out.writeTo(module);
+            };
+        }
+        if (!options.incrementalDir.empty()) {
+            std::ostringstream ir;
+            incremental::compile(*std::dynamic_pointer_cast<ast::Funcs>(program), options.incrementalDir, ir);
+            output::Rope out;
+            out.adopt(ir.str());
+            target(out);
+        } else {
+            ir::PassReport report;
+            parallelgen::compile(*std::dynamic_pointer_cast<ast::Funcs>(program), options.genThreads, target,
+                                 options.inlining, options.passReport ? &report : nullptr);
+            if (options.passReport) {
+                report.print(std::cerr);
+            }
+        }
+        if (options.optLevel >= 0) {
+            output::Rope out;
+            out.adopt(llvmopt::optimize(module.str(), options.optLevel));
+            sink(out);
+        }
+    } catch (const output::CompileError &e) {
+        // Compilation errors are only found before any code is generated, so nothing was written yet
+        output::Rope out;
+        out.append(e.what(), strlen(e.what()));
+        sink(out);
+        return false;
+    }
+    return true;
+}
+
+bool CompilerSession::compile(const std::string &makor, std::ostream &os) {
+    return compile(makor, [&](output::Rope &out) {
+        out.writeTo(os);
+    });
+}
+
+bool CompilerSession::compile(const std::string &makor, int fd) {
+    return compile(makor, [fd](output::Rope &out) {
+        out.writeTo(fd);
+    });
+}
@@ -0,0 +1,62 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include "nodes.hpp"
+#include "output.hpp"
+#include "parallelgen.hpp"
+
+/* Options of a compilation, see the usage in main.cpp */
+struct SessionOptions {
+    // Parse with the hand-written recursive descent parser instead of bison
+    bool rd = false;
+    // Stop after building the AST
+    bool parseOnly = false;
+    // Stop after the semantic analysis
+    bool checkOnly = false;
+    // Number of threads checking function bodies
+    int checkThreads = 1;
+    // Number of threads generating functions
+    int genThreads = 1;
+    // Directory of the AST cache, empty for none
+    std::string astCacheDir;
+    // Directory of the per-function IR cache, empty to generate every function
+    std::string incrementalDir;
+    // Level of the LLVM pipeline run on the module (-O0 to -O3), -1 to print the module as generated
+    int optLevel = -1;
+    // Inline small functions into their callers
+    bool inlining = true;
+    // Print the number of instructions after every IR pass to stderr
+    bool passReport = false;
+};
+
+/* CompilerSession
+ * One compilation from FanC source to LLVM IR. Everything the compilation uses (the scanner, the parser's result,
+ * the symbol tables and the code buffers) belongs to the session, so sessions can be created, run and destroyed
+ * repeatedly in one process, and several sessions can run at the same time on different threads.
+ */
+class CompilerSession {
+private:
+    SessionOptions options;
+    std::shared_ptr<ast::Node> program;
+
+    // Lexes, parses and checks the source, or loads its AST from the AST cache
+    void frontEnd(const std::string &makor);
+
+    // Compiles the source and hands the IR or the error message to the sink
+    bool compile(const std::string &makor, const parallelgen::Sink &sink);
+
+public:
+    explicit CompilerSession(const SessionOptions &options = SessionOptions());
+
+    // Compiles the source and writes the IR to os. On a compilation error the message the tests expect is written
+    // to os instead, and false is returned
+    bool compile(const std::string &makor, std::ostream &os);
+
+    // Same, writing straight to the file descriptor with writev. Every function is written as soon as it is generated
+    bool compile(const std::string &makor, int fd);
+};
+
+#endif //SESSION_HPP
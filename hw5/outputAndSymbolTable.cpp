@@ -7,49 +7,32 @@
  // The <algorithm> header provides standard algorithms that operate on containers.
 // For example, `std::find_if`, which is used to search for elements in a range that satisfy a given condition.
 
-#include "output.hpp"
+#include "outputAndSymbolTable.hpp"
  // This is a custom header file, which declares various functions, classes, and variables related 
 // to semantic analysis, error reporting, and scope printing for a compiler's intermediate representation.
 
-#define CAST_TO_FORMAL(mishtane) std::dynamic_pointer_cast < ast::Formal > (mishtane)
-// This macro simplifies the repetitive task of casting a `std::shared_ptr<ast::Node>` 
-// to `std::shared_ptr<ast::Formal>` using `std::dynamic_pointer_cast`. It takes a single argument, `mishtane` 
-// (Hebrew for "variable").
-
-#define CAST_TO_VARDECL(mishtane) std::dynamic_pointer_cast < ast::VarDecl > (mishtane)
-// Similarly, this macro casts a `std::shared_ptr<ast::Node>` to a `std::shared_ptr<ast::VarDecl>`.
-
-namespace output {
-    // All the functionality defined here is encapsulated in the `output` namespace. 
-    // This helps organize code and avoid name conflicts with other parts of the program.
-
-    // Declaring a global vector to track variables within the current scope.
-    std::vector < std::shared_ptr < ast::Node >> mishtaneMisgeret;
-    // Each element in this vector represents a variable or formal parameter 
-    // (wrapped as `std::shared_ptr<ast::Node>`), enabling efficient scope management.
-
-    // Keeps track of the number of variables in each active scope.
-    std::vector < int > MisparMishtaneNokhehi;
-    // For each scope, the last element indicates how many variables are defined. 
-    // This is used during scope cleanup to remove all variables introduced in a scope.
-
-    // Stores globally defined functions, represented as `ast::FuncDecl`.
-    std::vector < std::shared_ptr < ast::FuncDecl >> HatsharatMishtaneGlobali;
-
-    // Tracks nodes associated with global variable usage or function calls.
-    std::vector < std::shared_ptr < ast::Node >> KriatMishtaneGlobali;
+#include "output.hpp"
+ // Declares output::CompileError, which the error functions below throw instead of exiting.
 
-    // Tracks the return type of the current function being analyzed.
-    ast::BuiltInType returnType;
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+ // Used to check the function bodies on several threads, see ScopePrinter::checkBodiesInParallel.
 
-    // Boolean flag to indicate whether the current operation involves a function call.
-    bool zoKria = false;
+#define CAST_TO_FORMAL(mishtane) dynamic_cast < ast::Formal * > ((mishtane).get())
+// This macro simplifies the repetitive task of casting a `std::shared_ptr<ast::Node>` 
+// to an `ast::Formal *` using `dynamic_cast`. It takes a single argument, `mishtane` 
+// (Hebrew for "variable"). A raw pointer is enough for the lookups and does not touch the reference count,
+// which is shared between the threads checking function bodies.
 
-    // Boolean flag to indicate whether variables are in use or not.
-    bool shimush = true;
+#define CAST_TO_VARDECL(mishtane) dynamic_cast < ast::VarDecl * > ((mishtane).get())
+// Similarly, this macro casts a `std::shared_ptr<ast::Node>` to an `ast::VarDecl *`.
 
-    // Tracks the total number of variables declared, used for offset calculations.
-    int moneMishtanim = 0;
+namespace outputAndSymbolTable {
+    // All the functionality defined here is encapsulated in the `outputAndSymbolTable` namespace. 
+    // This helps organize code and avoid name conflicts with other parts of the program.
 
     // ScopePrinter::visit(ast::Funcs&)
     // This method processes the `Funcs` node in the Abstract Syntax Tree (AST),
@@ -91,7 +74,7 @@ namespace output {
 
             // Prepare the list of parameter types for logging purposes.
             std::vector < ast::BuiltInType > tippusim;
-            for (auto haFormalHaNokhehi: formalsHadpasa -> formals) {
+            for (const auto & haFormalHaNokhehi: formalsHadpasa -> formals) {
                 tippusim.push_back(haFormalHaNokhehi -> type -> type);
             }
 
@@ -116,7 +99,7 @@ namespace output {
                 }) == HatsharatMishtaneGlobali.end()) {
             HatsharatMishtaneGlobali.push_back(HatsharatHadpasaI);
             std::vector < ast::BuiltInType > tippusimI;
-            for (auto haFormalHaNokhehi: formalsHadpasaI -> formals) {
+            for (const auto & haFormalHaNokhehi: formalsHadpasaI -> formals) {
                 tippusimI.push_back(haFormalHaNokhehi -> type -> type);
             }
             emitFunc(mezaheHadpasaI -> value, tippusHahzaratHadpasaI -> type, tippusimI);
@@ -124,14 +107,14 @@ namespace output {
 
         // Ensure the main function exists, matches the signature, and check for duplicates.
         bool mainKayyam = false;
-        for (auto funktsiyya: node.funcs) {
+        for (const auto & funktsiyya: node.funcs) {
             if (funktsiyya -> id -> value == "main") {
                 mainKayyam = true;
                 if (!funktsiyya -> formals -> formals.empty() || funktsiyya -> return_type -> type != ast::BuiltInType::VOID) {
                     errorMainMissing();
                 }
             }
-            for (auto existingFunc: HatsharatMishtaneGlobali) {
+            for (const auto & existingFunc: HatsharatMishtaneGlobali) {
                 if (existingFunc -> id -> value == funktsiyya -> id -> value) {
                     errorDef(funktsiyya -> id -> line, funktsiyya -> id -> value);
                 }
@@ -139,7 +122,7 @@ namespace output {
 
             HatsharatMishtaneGlobali.push_back(funktsiyya);
             std::vector < ast::BuiltInType > tippusim;
-            for (auto haFormalHaNokhehi: funktsiyya -> formals -> formals) {
+            for (const auto & haFormalHaNokhehi: funktsiyya -> formals -> formals) {
                 tippusim.push_back(haFormalHaNokhehi -> type -> type);
             }
             emitFunc(funktsiyya -> id -> value, funktsiyya -> return_type -> type, tippusim);
@@ -150,14 +133,103 @@ namespace output {
             errorMainMissing();
         }
 
+        // The bodies only read the signatures collected above, so they can be checked at the same time.
+        if (hutim > 1 && node.funcs.size() > 1) {
+            checkBodiesInParallel(node.funcs);
+            return;
+        }
+
         // Visit each function in the list, processing its body and associated declarations.
         for (auto mehazrer: node.funcs) {
             moneMishtanim = 0;
             mehazrer -> accept( * this);
         }
+    }
+
+    void ScopePrinter::checkBodiesInParallel(std::vector < std::shared_ptr < ast::FuncDecl >> & funcs) {
+        const int misparHutim = std::min < int > (hutim, funcs.size());
+
+        // Every thread starts with a contiguous share of the functions. It takes work from the front of its own deque,
+        // and once that is empty it steals from the back of the others.
+        struct Tor {
+            std::mutex mutex;
+            std::deque < size_t > mesimot;
+        };
+        std::vector < Tor > torim(misparHutim);
+        for (size_t haIndeks = 0; haIndeks < funcs.size(); haIndeks++) {
+            torim[haIndeks * misparHutim / funcs.size()].mesimot.push_back(haIndeks);
+        }
 
-        // Output the complete scope information for debugging purposes.
-        std::cout << * this;
+        auto kahMesima = [ & ](int hut, size_t & mesima) {
+            for (int haIndeks = 0; haIndeks < misparHutim; haIndeks++) {
+                Tor & tor = torim[(hut + haIndeks) % misparHutim];
+                std::lock_guard < std::mutex > lock(tor.mutex);
+                if (tor.mesimot.empty()) {
+                    continue;
+                }
+                if (haIndeks == 0) {
+                    mesima = tor.mesimot.front();
+                    tor.mesimot.pop_front();
+                } else {
+                    mesima = tor.mesimot.back();
+                    tor.mesimot.pop_back();
+                }
+                return true;
+            }
+            return false;
+        };
+
+        // The scope dump of every function, and the error of every function that failed
+        std::vector < std::string > shivrim(funcs.size());
+        std::vector < std::exception_ptr > shgiot(funcs.size());
+        // Index of the first function that failed so far; the functions after it need no checking,
+        // a sequential run would have stopped before them.
+        std::atomic < size_t > shgiaRishona(funcs.size());
+
+        auto oved = [ & ](int hut) {
+            ScopePrinter printer;
+            printer.HatsharatMishtaneGlobali = HatsharatMishtaneGlobali;
+            size_t mesima;
+            while (kahMesima(hut, mesima)) {
+                if (mesima > shgiaRishona) {
+                    continue;
+                }
+                // A failed function leaves its scopes open, so every function starts from an empty scope stack.
+                printer.mishtaneMisgeret.clear();
+                printer.MisparMishtaneNokhehi.clear();
+                printer.moneMishtanim = 0;
+                printer.hafsakaVeHemshekhHukiyim = 0;
+                printer.zoKria = false;
+                printer.shimush = true;
+                printer.indentLevel = 0;
+                printer.buffer.str("");
+                try {
+                    funcs[mesima] -> accept(printer);
+                    shivrim[mesima] = printer.buffer.str();
+                } catch (...) {
+                    shgiot[mesima] = std::current_exception();
+                    size_t kodem = shgiaRishona;
+                    while (mesima < kodem && !shgiaRishona.compare_exchange_weak(kodem, mesima)) {
+                    }
+                }
+            }
+        };
+
+        std::vector < std::thread > hutimPailim;
+        for (int hut = 1; hut < misparHutim; hut++) {
+            hutimPailim.emplace_back(oved, hut);
+        }
+        oved(0); // The calling thread is one of the workers.
+        for (std::thread & hut: hutimPailim) {
+            hut.join();
+        }
+
+        if (shgiaRishona < funcs.size()) {
+            std::rethrow_exception(shgiot[shgiaRishona]);
+        }
+        for (const std::string & shever: shivrim) {
+            buffer << shever;
+        }
     }
 
     void ScopePrinter::visit(ast::FuncDecl & node) {
@@ -209,14 +281,14 @@ namespace output {
         node.type -> accept( * this);
 
         // Ensure the parameter's name does not conflict with existing variables or parameters in the scope.
-        for (auto mishtane: mishtaneMisgeret) {
+        for (const auto & mishtane: mishtaneMisgeret) {
             if (CAST_TO_FORMAL(mishtane) -> id -> value == node.id -> value) {
                 errorDef(node.id -> line, node.id -> value); // Report a duplicate parameter error.
             }
         }
 
         // Ensure the parameter's name does not conflict with globally defined functions.
-        for (auto funktsiyya: HatsharatMishtaneGlobali) {
+        for (const auto & funktsiyya: HatsharatMishtaneGlobali) {
             if (funktsiyya -> id -> value == node.id -> value) {
                 errorDef(node.id -> line, node.id -> value); // Report a conflict with a function name.
             }
@@ -245,7 +317,7 @@ namespace output {
         bool zeBituy = false;
 
         // Iterate over all variables in the current scope to find the target variable.
-        for (auto mishtane: mishtaneMisgeret) {
+        for (const auto & mishtane: mishtaneMisgeret) {
             if (CAST_TO_VARDECL(mishtane)) {
                 if (CAST_TO_VARDECL(mishtane) -> id -> value == node.id -> value) {
                     loKayyam = false; // The variable exists in the current scope.
@@ -274,7 +346,7 @@ namespace output {
 
         // If the variable does not exist, check global functions and report an error if necessary.
         if (loKayyam) {
-            for (auto funktsiyya: HatsharatMishtaneGlobali) {
+            for (const auto & funktsiyya: HatsharatMishtaneGlobali) {
                 if (funktsiyya -> id -> value == node.id -> value) {
                     errorDefAsFunc(node.line, funktsiyya -> id -> value);
                 }
@@ -304,7 +376,7 @@ namespace output {
 
         // Ensure the variable name does not conflict with existing variables or parameters in the scope.
         bool kvarKayyam = false;
-        for (auto mishtane: mishtaneMisgeret) {
+        for (const auto & mishtane: mishtaneMisgeret) {
             if (CAST_TO_VARDECL(mishtane)) {
                 if (CAST_TO_VARDECL(mishtane) -> id -> value == node.id -> value) {
                     kvarKayyam = true; // Variable already exists in the scope.
@@ -323,7 +395,7 @@ namespace output {
 
         // Ensure the variable name does not conflict with globally defined functions.
         if (!kvarKayyam) {
-            for (auto funktsiyya: HatsharatMishtaneGlobali) {
+            for (const auto & funktsiyya: HatsharatMishtaneGlobali) {
                 if (funktsiyya -> id -> value == node.id -> value) {
                     errorDefAsFunc(node.line, funktsiyya -> id -> value);
                 }
@@ -508,7 +580,7 @@ namespace output {
         bool funktsiyyaKayyemet = false;
 
         // Search for the function in the global list of function declarations.
-        for (auto funktsiyya: HatsharatMishtaneGlobali) {
+        for (const auto & funktsiyya: HatsharatMishtaneGlobali) {
             if (funktsiyya -> id -> value == node.func_id -> value) {
                 // Function exists; validate its parameters and return type.
                 node.type = funktsiyya -> return_type -> type;
@@ -516,29 +588,14 @@ namespace output {
 
                 // Validate each argument against the corresponding parameter.
                 int haIndeks = 0;
-                for (auto haFormalHaNokhehi: funktsiyya -> formals -> formals) {
-                    
-                    bool mishtaneKayyam = false;
-                    for (auto mishtane: mishtaneMisgeret) {
-                        if (CAST_TO_VARDECL(mishtane)) {
-                            if (CAST_TO_VARDECL(mishtane) -> id -> value == node.args -> exps[haIndeks] -> erekhBituy) {
-                                mishtaneKayyam = true;
-                            }
-                        }
-                        if (CAST_TO_FORMAL(mishtane)) {
-                            if (CAST_TO_FORMAL(mishtane) -> id -> value == node.args -> exps[haIndeks] -> erekhBituy) {
-                                mishtaneKayyam = true;
-                            }
-                        }
-                    }
-                    
+                for (const auto & haFormalHaNokhehi: funktsiyya -> formals -> formals) {
                     // Ensure the argument matches the parameter's type or is convertible.
                     if ((haFormalHaNokhehi -> type -> type != node.args -> exps[haIndeks] -> type &&
                             !(haFormalHaNokhehi -> type -> type == ast::BuiltInType::INT &&
                                 node.args -> exps[haIndeks] -> type == ast::BuiltInType::BYTE)) ||
                         funktsiyya -> formals -> formals.size() != node.args -> exps.size()) {
                         std::vector < std::string > tippusim;
-                        for (auto haFormalHaNokhehi: funktsiyya -> formals -> formals) {
+                        for (const auto & haFormalHaNokhehi: funktsiyya -> formals -> formals) {
                             switch (haFormalHaNokhehi -> type -> type) {
                             case ast::BuiltInType::VOID:
                                 tippusim.push_back("VOID");
@@ -566,7 +623,7 @@ namespace output {
         // If the function does not exist, report it.
         if (!funktsiyyaKayyemet) {
 
-            for (auto mishtane: mishtaneMisgeret) {
+            for (const auto & mishtane: mishtaneMisgeret) {
                 if (CAST_TO_VARDECL(mishtane) -> id -> value == node.func_id -> value) {
                     errorDefAsVar(node.line, node.func_id -> value);
                 }
@@ -688,15 +745,12 @@ namespace output {
     }
 
     void ScopePrinter::visit(ast::ID & node) {
-        // Store the identifier's name for error reporting.
-        node.erekhBituy = node.value;
-
         // If variable/function usage checks are enabled:
         if (shimush) {
             bool loKayyam = true; // Track whether the identifier is undefined.
 
             // Search through the current scope for the variable declaration.
-            for (auto mishtane: mishtaneMisgeret) {
+            for (const auto & mishtane: mishtaneMisgeret) {
                 if (CAST_TO_VARDECL(mishtane)) {
                     if (CAST_TO_VARDECL(mishtane) -> id -> value == node.value) {
                         node.type = CAST_TO_VARDECL(mishtane) -> type -> type; // Assign its type.
@@ -724,7 +778,7 @@ namespace output {
             }
 
             // Check global function declarations for the identifier.
-            for (auto funktsiyya: HatsharatMishtaneGlobali) {
+            for (const auto & funktsiyya: HatsharatMishtaneGlobali) {
                 if (funktsiyya -> id -> value == node.value) {
                     // If it is a function and being used as a variable, report an error.
                     if (!zoKria) {
@@ -854,106 +908,119 @@ namespace output {
         return totsaa; // Return the constructed indentation string.
     }
 
-    ScopePrinter::ScopePrinter(): indentLevel(0) {
+    ScopePrinter::ScopePrinter(int hutim): indentLevel(0), hutim(hutim) {
         // Constructor initializes the indentation level to zero.
     }
 
     void errorByteTooLarge(int lineno,
         const int value) {
+        std::ostringstream message;
         // Report an error for a byte value that is out of the valid range (0-255).
-        std::cout << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": byte value " << value << " out of range" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorMainMissing() {
+        std::ostringstream message;
         // Report an error indicating the absence of the mandatory 'main' function.
-        std::cout << "Program has no 'void main()' function" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "Program has no 'void main()' function" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorUnexpectedContinue(int lineno) {
+        std::ostringstream message;
         // Report an error for an unexpected 'continue' statement outside of a loop.
-        std::cout << "line " << lineno << ": unexpected continue statement" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": unexpected continue statement" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorUnexpectedBreak(int lineno) {
+        std::ostringstream message;
         // Report an error for an unexpected 'break' statement outside of a loop.
-        std::cout << "line " << lineno << ": unexpected break statement" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": unexpected break statement" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorPrototypeMismatch(int lineno,
         const std::string & id, std::vector < std::string > & tippusim) {
+        std::ostringstream message;
         // Report a mismatch between the expected and provided parameter types in a function call.
-        std::cout << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
+        message << "line " << lineno << ": prototype mismatch, function " << id << " expects parameters (";
 
         // Append the expected parameter types to the error message.
         for (int haIndeks = 0; haIndeks < tippusim.size(); ++haIndeks) {
-            std::cout << tippusim[haIndeks];
+            message << tippusim[haIndeks];
             if (haIndeks != tippusim.size() - 1) {
-                std::cout << ","; // Add a comma between parameter types.
+                message << ","; // Add a comma between parameter types.
             }
         }
 
-        std::cout << ")" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << ")" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorMismatch(int lineno) {
+        std::ostringstream message;
         // Report a generic type mismatch error in an expression or assignment.
-        std::cout << "line " << lineno << ": type mismatch" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": type mismatch" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorUndefFunc(int lineno,
         const std::string & id) {
+        std::ostringstream message;
         // Report an error for the usage of an undefined function.
-        std::cout << "line " << lineno << ": function " << id << " is not defined" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": function " << id << " is not defined" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorDef(int lineno,
         const std::string & id) {
+        std::ostringstream message;
         // Report an error for a redefinition of a symbol (variable or function).
-        std::cout << "line " << lineno << ": symbol " << id << " is already defined" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": symbol " << id << " is already defined" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorDefAsVar(int lineno,
         const std::string & id) {
+        std::ostringstream message;
         // Report an error for a function being used as a variable.
-        std::cout << "line " << lineno << ": symbol " << id << " is a variable" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": symbol " << id << " is a variable" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorDefAsFunc(int lineno,
         const std::string & id) {
+        std::ostringstream message;
         // Report an error for a variable being used as a function.
-        std::cout << "line " << lineno << ": symbol " << id << " is a function" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": symbol " << id << " is a function" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorUndef(int lineno,
         const std::string & id) {
+        std::ostringstream message;
         // Report an error for the usage of an undefined variable.
-        std::cout << "line " << lineno << ": variable " << id << " is not defined" << std::endl;
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": variable " << id << " is not defined" << std::endl;
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorSyn(int lineno) {
+        std::ostringstream message;
         // Report a syntax error in the input.
-        std::cout << "line " << lineno << ": syntax error\n";
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": syntax error\n";
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
     void errorLex(int lineno) {
+        std::ostringstream message;
         // Report a lexical error in the input.
-        std::cout << "line " << lineno << ": lexical error\n";
-        exit(0); // Exit the program as the error is critical.
+        message << "line " << lineno << ": lexical error\n";
+        throw output::CompileError(message.str()); // Abort the compilation as the error is critical.
     }
 
-    void exitFrame() {
+    void ScopePrinter::exitFrame() {
         // Remove all variables declared in the current frame from the symbol table.
         if (!MisparMishtaneNokhehi.empty()) {
             for (int haIndeks = 0; haIndeks < MisparMishtaneNokhehi.back(); haIndeks++) {
@@ -964,7 +1031,7 @@ namespace output {
         }
     }
 
-    void enrtyFrame() {
+    void ScopePrinter::enrtyFrame() {
         // Add a new frame to track the number of variables in the current scope.
         MisparMishtaneNokhehi.push_back(0);
     }
@@ -39,18 +39,6 @@ namespace outputAndSymbolTable {
 
     void errorByteTooLarge(int lineno, int value);
     
-    extern std::vector<std::shared_ptr<ast::Node>> mishtaneMisgeret;
-    extern std::vector<int> MisparMishtaneNokhehi;
-    extern std::vector<std::shared_ptr<ast::FuncDecl>> HatsharatMishtaneGlobali;
-    extern std::vector<std::shared_ptr<ast::Node>> KriatMishtaneGlobali;
-
-    void enrtyFrame();
-    void exitFrame();
-    extern ast::BuiltInType returnType;
-    extern int moneMishtanim;
-    extern bool zoKria;
-    extern bool shimush;
-
     /* ScopePrinter class
      * This class is used to print scopes in a human-readable format.
      */
@@ -59,12 +47,42 @@ namespace outputAndSymbolTable {
 
         int hafsakaVeHemshekhHukiyim = 0;
 
+        // The state of the analysis lives in the printer, so that every compilation starts from a clean state
+
+        // Variables and formals of the enclosing scopes, innermost last
+        std::vector<std::shared_ptr<ast::Node>> mishtaneMisgeret;
+        // Number of variables each enclosing scope declared
+        std::vector<int> MisparMishtaneNokhehi;
+        // Declared functions, including print and printi
+        std::vector<std::shared_ptr<ast::FuncDecl>> HatsharatMishtaneGlobali;
+        // Return type of the function being analyzed
+        ast::BuiltInType returnType = ast::BuiltInType::VOID;
+        // Offset of the next variable
+        int moneMishtanim = 0;
+        // True while the arguments of a call are analyzed
+        bool zoKria = false;
+        // False while declarations are visited, so their identifiers are not looked up as uses
+        bool shimush = true;
+
+        void enrtyFrame();
+
+        void exitFrame();
+
         std::stringstream globalsBuffer;
         std::stringstream buffer;
         int indentLevel;
 
+        // Number of threads checking function bodies
+        int hutim;
+
+        // Checks the bodies of the functions on a work-stealing pool of threads, each with a printer of its own.
+        // The scope dumps of the functions are appended in source order and the error of the first failing
+        // function is rethrown, so the result is the same as checking them one after the other
+        void checkBodiesInParallel(std::vector<std::shared_ptr<ast::FuncDecl>> &funcs);
+
     public:
-        ScopePrinter();
+        // hutim is the number of threads checking function bodies, 1 checks them on the calling thread
+        explicit ScopePrinter(int hutim = 1);
 
         void beginScope();
 
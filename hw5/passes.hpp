@@ -0,0 +1,100 @@
+#ifndef PASSES_HPP
+#define PASSES_HPP
+
+#include "ir.hpp"
+#include <mutex>
+#include <ostream>
+
+/* IR passes
+ * Transformations of a lowered function, run by the generator between lowering and printing.
+ */
+namespace ir {
+
+    class InlineLibrary;
+
+    /* Builds SSA form: every slot of an alloca whose address does not escape becomes a series of registers, and
+     * phis join the values that reach a block along different edges. The promoted allocas are removed.
+     */
+    void buildSsa(Function &function);
+
+    /* Turns the calls of a function to itself in tail position into jumps back to the start of its body, where phis
+     * of the parameters take the arguments, so deep recursion runs in one frame. Runs on SSA form before inlining,
+     * see tailcalls.cpp
+     */
+    void eliminateTailRecursion(Function &function);
+
+    /* Replaces the calls to small functions that are finished already by copies of their bodies, see inliner.hpp.
+     * Runs on SSA form before the other passes, so they see the arguments' values in the inlined code.
+     */
+    void inlineCalls(Function &function, InlineLibrary &library);
+
+    /* Evaluates an instruction whose operands are all constants, with the wraparound of i32 arithmetic. Fails (returns
+     * false) for opcodes without a value and for divisions that would trap, which are left to run.
+     */
+    bool fold(Opcode op, Type type, Predicate pred, const Value *ops, Value &result);
+
+    /* Sparse conditional constant propagation (Wegman and Zadeck) over a function in SSA form. Registers that are
+     * constant on every executable path are replaced by the constant, branches on constants become jumps, and the
+     * blocks no executable edge reaches are removed.
+     */
+    void propagateConstants(Function &function);
+
+    /* Simplifies the control flow graph: removes unreachable blocks, turns branches on constants into jumps, bypasses
+     * blocks that only jump on and merges straight-line chains of blocks, see simplifycfg.cpp
+     */
+    void simplifyCfg(Function &function);
+
+    /* Removes the masks that cannot change their operand, as a value range analysis shows: an `and` with 2^k - 1 of
+     * a value in 0..2^k - 1, a byte widened back to the int it was cut from when that int was in 0..255, and a byte
+     * cut back from its widened value.
+     */
+    void removeMasks(Function &function);
+
+    /* Removes the calls to check_division whose divisor a value range analysis proves nonzero, see ranges.cpp */
+    void removeDivisionChecks(Function &function);
+
+    /* Rotates every while loop whose test has no side effects into a do-while guarded by a copy of the test, so an
+     * iteration takes one branch instead of two, see loops.cpp
+     */
+    void rotateLoops(Function &function);
+
+    /* Replaces the remaining calls to check_division by a comparison and a branch to one error block per function,
+     * which prints the runtime's error message and exits. Runs after the passes that reason about whole blocks, as it splits them.
+     */
+    void lowerDivisionChecks(Function &function);
+
+    /* Moves the instructions of a loop that compute the same value on every iteration and cannot trap to the block
+     * that enters the loop, the comparisons of the division checks among them.
+     */
+    void hoistInvariants(Function &function);
+
+    /* Rewrites single instructions by a table of rules: identities like x + 0 and x * 1 become their operand, x * 0
+     * and x - x become 0, and multiplications and divisions by 2^k become shifts. Also turns a phi of true and false
+     * behind the arms of a branch into the branch's condition, see peephole.cpp
+     */
+    void peephole(Function &function);
+
+    /* Marks the calls in tail position `musttail` when the callee has the caller's prototype and its result is returned
+     * as it is, and `tail` otherwise. Runs last, as a pass that moves code after it could break the marker.
+     */
+    void markTailCalls(Function &function);
+
+    /* The number of instructions of a program after every pass, summed over its functions. The generators of all the
+     * functions share one report, on as many threads as there are.
+     */
+    class PassReport {
+    private:
+        std::mutex mutex;
+        // The passes in the order they first ran, and their counts
+        std::vector<std::pair<std::string, unsigned long>> counts;
+
+    public:
+        // Adds the size of the function after the pass
+        void add(const std::string &pass, const Function &function);
+
+        // Prints every pass with its count and the change from the pass before it
+        void print(std::ostream &os);
+    };
+}
+
+#endif //PASSES_HPP
@@ -0,0 +1,39 @@
+#include "passes.hpp"
+#include <algorithm>
+#include <iomanip>
+
+namespace ir {
+
+    void PassReport::add(const std::string &pass, const Function &function) {
+        unsigned long size = 0;
+        for (Block *block = function.first; block; block = block->next) {
+            for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                size++;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = std::find_if(counts.begin(), counts.end(),
+                                  [&pass](const std::pair<std::string, unsigned long> &count) {
+                                      return count.first == pass;
+                                  });
+        if (found == counts.end()) {
+            counts.emplace_back(pass, size);
+        } else {
+            found->second += size;
+        }
+    }
+
+    void PassReport::print(std::ostream &os) {
+        std::lock_guard<std::mutex> lock(mutex);
+        os << std::left << std::setw(28) << "pass" << std::right << std::setw(14) << "instructions" << std::setw(10)
+           << "change" << '\n';
+        for (size_t i = 0; i < counts.size(); i++) {
+            os << std::left << std::setw(28) << counts[i].first << std::right << std::setw(14) << counts[i].second;
+            if (i > 0) {
+                os << std::setw(10) << std::showpos << (long) counts[i].second - (long) counts[i - 1].second
+                   << std::noshowpos;
+            }
+            os << '\n';
+        }
+    }
+}
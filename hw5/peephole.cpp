@@ -0,0 +1,314 @@
+#include "passes.hpp"
+#include "cfg.hpp"
+
+/* Peephole optimization
+ * Every arithmetic instruction is looked up in the table of rules below by its opcode and right operand (the constant
+ * of a commutative one is moved to the right first). A rule either replaces the instruction by its left operand or by
+ * zero, or reduces it to shifts:
+ * - x * 2^k is x << k, and a byte x / 2^k is x >>> k
+ * - an int x / 2^k rounds toward zero, so a negative x is biased by 2^k - 1 first: (x + (x >> 31 >>> 32 - k)) >> k
+ * A few patterns span more than one instruction:
+ * - a phi of true and false along the two arms of a conditional branch is the branch's condition or its negation,
+ *   widened for a bool kept as an int
+ * - a widened bool compared with 0 is the bool, and a branch on a negated bool branches the other way
+ * Last, the instructions whose values are no longer used are removed.
+ */
+namespace ir {
+
+    enum class Operand : unsigned char {
+        ZERO,
+        ONE,
+        // -1 of an int, 255 of a byte
+        ALL_ONES,
+        // 2^k with k >= 1
+        POWER_OF_TWO,
+        // The left operand again
+        SAME
+    };
+
+    enum class Rewrite : unsigned char {
+        LEFT,
+        ZERO,
+        SHL,
+        LSHR,
+        SIGNED_SHIFT
+    };
+
+    struct Rule {
+        Opcode op;
+        Operand right;
+        Rewrite rewrite;
+    };
+
+    // The first rule that matches is applied, so ONE comes before POWER_OF_TWO
+    static const Rule RULES[] = {
+            {Opcode::ADD,  Operand::ZERO,         Rewrite::LEFT},
+            {Opcode::SUB,  Operand::ZERO,         Rewrite::LEFT},
+            {Opcode::SUB,  Operand::SAME,         Rewrite::ZERO},
+            {Opcode::MUL,  Operand::ZERO,         Rewrite::ZERO},
+            {Opcode::MUL,  Operand::ONE,          Rewrite::LEFT},
+            {Opcode::MUL,  Operand::POWER_OF_TWO, Rewrite::SHL},
+            {Opcode::SDIV, Operand::ONE,          Rewrite::LEFT},
+            {Opcode::SDIV, Operand::POWER_OF_TWO, Rewrite::SIGNED_SHIFT},
+            {Opcode::UDIV, Operand::ONE,          Rewrite::LEFT},
+            {Opcode::UDIV, Operand::POWER_OF_TWO, Rewrite::LSHR},
+            {Opcode::AND,  Operand::ZERO,         Rewrite::ZERO},
+            {Opcode::AND,  Operand::ALL_ONES,     Rewrite::LEFT},
+            {Opcode::AND,  Operand::SAME,         Rewrite::LEFT},
+            {Opcode::XOR,  Operand::ZERO,         Rewrite::LEFT},
+            {Opcode::XOR,  Operand::SAME,         Rewrite::ZERO},
+            {Opcode::SHL,  Operand::ZERO,         Rewrite::LEFT},
+            {Opcode::LSHR, Operand::ZERO,         Rewrite::LEFT},
+            {Opcode::ASHR, Operand::ZERO,         Rewrite::LEFT},
+    };
+
+    static bool commutes(Opcode op) {
+        return op == Opcode::ADD || op == Opcode::MUL || op == Opcode::AND || op == Opcode::XOR;
+    }
+
+    // The k of a constant 2^k with k >= 1, 0 for other values
+    static int exponent(const Value &value) {
+        uint32_t n = value.n;
+        if (!value.isConst() || n < 2 || (n & (n - 1)) != 0 || (value.type == Type::I32 && value.n < 0)) {
+            return 0;
+        }
+        int k = 0;
+        while (n > 1) {
+            n >>= 1;
+            k++;
+        }
+        return k;
+    }
+
+    static bool matches(Operand operand, const Value *ops) {
+        const Value &right = ops[1];
+        switch (operand) {
+            case Operand::ZERO:
+                return right.isConst() && right.n == 0;
+            case Operand::ONE:
+                return right.isConst() && right.n == 1;
+            case Operand::ALL_ONES:
+                return right.isConst() &&
+                       right.n == (right.type == Type::I8 ? UINT8_MAX : right.type == Type::I1 ? 1 : -1);
+            case Operand::POWER_OF_TWO:
+                return exponent(right) > 0;
+            default:
+                return ops[0].isReg() && right.isReg() && ops[0].n == right.n;
+        }
+    }
+
+    class Peephole {
+    private:
+        Function &function;
+        // Value that replaces a removed instruction, indexed by its register
+        std::vector<Value> replacement;
+        std::vector<Instruction *> definition;
+
+        Value resolve(Value value) const {
+            while (value.isReg() && replacement[value.n].kind != Value::Kind::NONE) {
+                value = replacement[value.n];
+            }
+            return value;
+        }
+
+        void replace(Instruction *instruction, const Value &value) {
+            replacement[instruction->result] = value;
+            instruction->block->remove(instruction);
+        }
+
+        // Adds an instruction that defines a new register before pos and returns the register
+        Value insert(Instruction *pos, Opcode op, Type type, std::initializer_list<Value> ops) {
+            Value result = function.newReg(type);
+            Instruction *instruction = function.create(op, type, result.n, ops);
+            pos->block->insertBefore(pos, instruction);
+            replacement.emplace_back();
+            definition.push_back(instruction);
+            return result;
+        }
+
+        void rewrite(Instruction *instruction) {
+            Value *ops = instruction->ops;
+            if (commutes(instruction->op) && ops[0].isConst() && !ops[1].isConst()) {
+                std::swap(ops[0], ops[1]);
+            }
+            for (const Rule &rule: RULES) {
+                if (rule.op != instruction->op || !matches(rule.right, ops)) {
+                    continue;
+                }
+                int k = exponent(ops[1]);
+                switch (rule.rewrite) {
+                    case Rewrite::LEFT:
+                        replace(instruction, ops[0]);
+                        break;
+                    case Rewrite::ZERO:
+                        replace(instruction, Value::constant(0, instruction->type));
+                        break;
+                    case Rewrite::SHL:
+                    case Rewrite::LSHR:
+                        instruction->op = rule.rewrite == Rewrite::SHL ? Opcode::SHL : Opcode::LSHR;
+                        ops[1] = Value::constant(k, instruction->type);
+                        break;
+                    case Rewrite::SIGNED_SHIFT: {
+                        // The bias is 2^k - 1 for a negative x and 0 otherwise: the top k bits of its sign
+                        Value sign = k == 1 ? ops[0] : insert(instruction, Opcode::ASHR, Type::I32,
+                                                              {ops[0], Value::constant(31)});
+                        Value bias = insert(instruction, Opcode::LSHR, Type::I32, {sign, Value::constant(32 - k)});
+                        ops[0] = insert(instruction, Opcode::ADD, Type::I32, {ops[0], bias});
+                        instruction->op = Opcode::ASHR;
+                        ops[1] = Value::constant(k);
+                        break;
+                    }
+                }
+                return;
+            }
+        }
+
+        /* A phi of true and false (1 and 0 of an int) whose two incoming edges are the two arms of one conditional
+         * branch, each either straight from the branch or through a block that only jumps on
+         */
+        void foldDiamond(Instruction *phi, const Cfg &cfg) {
+            const Value *ops = phi->ops;
+            if ((phi->type != Type::I1 && phi->type != Type::I32) || phi->numOps != 2 || !ops[0].isConst() ||
+                !ops[1].isConst() || ops[0].n + ops[1].n != 1 || ops[0].n * ops[1].n != 0) {
+                return;
+            }
+            Block *origin[2];
+            unsigned arm[2];
+            for (unsigned i = 0; i < 2; i++) {
+                Block *pred = phi->targets[i];
+                Block *from = phi->block;
+                if (pred->first == pred->last && pred->last->op == Opcode::BR && cfg.preds[pred->id].size() == 1) {
+                    from = pred;
+                    pred = cfg.preds[pred->id][0];
+                }
+                Instruction *branch = pred->last;
+                if (branch->op != Opcode::CONDBR || branch->targets[0] == branch->targets[1]) {
+                    return;
+                }
+                origin[i] = pred;
+                arm[i] = branch->targets[0] == from ? 0 : 1;
+            }
+            if (origin[0] != origin[1] || arm[0] == arm[1]) {
+                return;
+            }
+            Instruction *pos = phi;
+            while (pos->op == Opcode::PHI) {
+                pos = pos->next;
+            }
+            Value value = resolve(origin[0]->last->ops[0]);
+            // The value along the arm taken when the condition holds
+            if (!ops[arm[0] == 0 ? 0 : 1].n) {
+                value = insert(pos, Opcode::XOR, Type::I1, {value, Value::constant(1, Type::I1)});
+            }
+            if (phi->type == Type::I32) {
+                value = insert(pos, Opcode::ZEXT, Type::I32, {value});
+            }
+            replace(phi, value);
+        }
+
+        // A bool widened to an int and compared with 0 again is the bool, or its negation
+        void foldTest(Instruction *icmp) {
+            const Value *ops = icmp->ops;
+            Instruction *widen = ops[0].isReg() ? definition[ops[0].n] : nullptr;
+            if (!widen || widen->op != Opcode::ZEXT || widen->ops[0].type != Type::I1 || !ops[1].isConst() ||
+                ops[1].n != 0 || (icmp->pred != Predicate::NE && icmp->pred != Predicate::EQ)) {
+                return;
+            }
+            Value value = resolve(widen->ops[0]);
+            if (icmp->pred == Predicate::EQ) {
+                value = insert(icmp, Opcode::XOR, Type::I1, {value, Value::constant(1, Type::I1)});
+            }
+            replace(icmp, value);
+        }
+
+        // A branch on a negated bool branches on the bool the other way
+        void foldBranch(Instruction *branch) {
+            Instruction *negation = branch->ops[0].isReg() ? definition[branch->ops[0].n] : nullptr;
+            if (negation && negation->op == Opcode::XOR && negation->ops[1].isConst() && negation->ops[1].n == 1) {
+                branch->ops[0] = resolve(negation->ops[0]);
+                std::swap(branch->targets[0], branch->targets[1]);
+            }
+        }
+
+        // Removes the instructions without side effects whose values are no longer used, like a folded widening
+        void removeDead() {
+            std::vector<unsigned> uses(definition.size(), 0);
+            std::vector<Instruction *> dead;
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        if (instruction->ops[i].isReg()) {
+                            uses[instruction->ops[i].n]++;
+                        }
+                    }
+                }
+            }
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    if (instruction->op <= Opcode::TRUNC && uses[instruction->result] == 0) {
+                        dead.push_back(instruction);
+                    }
+                }
+            }
+            while (!dead.empty()) {
+                Instruction *instruction = dead.back();
+                dead.pop_back();
+                instruction->block->remove(instruction);
+                for (unsigned i = 0; i < instruction->numOps; i++) {
+                    const Value &op = instruction->ops[i];
+                    Instruction *operand = op.isReg() ? definition[op.n] : nullptr;
+                    if (operand && --uses[op.n] == 0 && operand->op <= Opcode::TRUNC) {
+                        dead.push_back(operand);
+                    }
+                }
+            }
+        }
+
+    public:
+        explicit Peephole(Function &function) : function(function) {}
+
+        void run() {
+            replacement.assign(function.regTypes.size(), Value());
+            definition.assign(function.regTypes.size(), nullptr);
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    if (instruction->result >= 0) {
+                        definition[instruction->result] = instruction;
+                    }
+                }
+            }
+            Cfg cfg(function);
+            for (Block *block = function.first; block; block = block->next) {
+                Instruction *next;
+                for (Instruction *instruction = block->first; instruction; instruction = next) {
+                    next = instruction->next;
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        instruction->ops[i] = resolve(instruction->ops[i]);
+                    }
+                    if (instruction->op == Opcode::PHI) {
+                        foldDiamond(instruction, cfg);
+                    } else if (instruction->op == Opcode::ICMP) {
+                        foldTest(instruction);
+                    } else if (instruction->op == Opcode::CONDBR) {
+                        foldBranch(instruction);
+                    } else if (instruction->op < Opcode::ICMP) {
+                        rewrite(instruction);
+                    }
+                }
+            }
+            // Phis and the instructions before their operands' definitions in the layout
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        instruction->ops[i] = resolve(instruction->ops[i]);
+                    }
+                }
+            }
+            removeDead();
+        }
+    };
+
+    void peephole(Function &function) {
+        Peephole(function).run();
+    }
+}
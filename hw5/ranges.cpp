@@ -0,0 +1,474 @@
+#include "passes.hpp"
+#include "cfg.hpp"
+#include <algorithm>
+
+/* Value ranges
+ * Every register gets an interval that holds all the values it can take (unsigned for an i8, a byte). The intervals
+ * are computed by iterating over the blocks in reverse postorder until nothing changes; a phi that keeps growing is
+ * widened to the end of its type's range, so the iteration stops. An operand is read in the block of its use, where
+ * the conditions of the branches that lead there narrow it: inside `while (i < n)`, i is at most INT_MAX - 1, so
+ * i + 1 cannot wrap around.
+ */
+namespace ir {
+
+    struct Range {
+        int64_t lo;
+        int64_t hi;
+
+        static Range full() {
+            return {INT32_MIN, INT32_MAX};
+        }
+
+        // All the values of a register of the type; an i8 is a byte, so its values are unsigned
+        static Range full(Type type) {
+            if (type == Type::I8) {
+                return {0, UINT8_MAX};
+            }
+            if (type == Type::I1) {
+                return {0, 1};
+            }
+            return full();
+        }
+
+        static Range empty() {
+            return {1, 0};
+        }
+
+        bool isEmpty() const {
+            return lo > hi;
+        }
+
+        bool contains(int64_t value) const {
+            return lo <= value && value <= hi;
+        }
+
+        Range join(const Range &other) const {
+            if (isEmpty()) {
+                return other;
+            }
+            if (other.isEmpty()) {
+                return *this;
+            }
+            return {std::min(lo, other.lo), std::max(hi, other.hi)};
+        }
+
+        Range meet(const Range &other) const {
+            return {std::max(lo, other.lo), std::min(hi, other.hi)};
+        }
+
+        bool operator==(const Range &other) const {
+            return (isEmpty() && other.isEmpty()) || (lo == other.lo && hi == other.hi);
+        }
+
+        // The result of an operation on values of the type, which wraps around once it leaves the type's range
+        static Range wrap(int64_t lo, int64_t hi, Type type = Type::I32) {
+            Range range = full(type);
+            if (lo < range.lo || hi > range.hi) {
+                return range;
+            }
+            return {lo, hi};
+        }
+    };
+
+    class RangeAnalysis {
+    private:
+        // Number of times a phi may grow before it is widened
+        static const int SAF_HARKHAVA = 3;
+
+        Function &function;
+        Cfg cfg;
+        std::vector<Range> ranges;
+        std::vector<int> growth;
+        // The comparison a block is guarded by: its only predecessor branches on it, and the block is on the side
+        // given by guardTaken
+        std::vector<Instruction *> guard;
+        std::vector<bool> guardTaken;
+        // The nearest block that dominates this one (itself included) and has a guard, nullptr for none
+        std::vector<Block *> nearestGuard;
+        std::vector<Instruction *> definition;
+
+        Range constant(const Value &value) const {
+            if (value.isConst()) {
+                return {value.n, value.n};
+            }
+            return ranges[value.n];
+        }
+
+        static Predicate negate(Predicate pred) {
+            static const Predicate negated[] = {Predicate::NONE, Predicate::NE, Predicate::EQ, Predicate::SLE,
+                                                Predicate::SLT, Predicate::SGE, Predicate::SGT};
+            return negated[(int) pred];
+        }
+
+        static Predicate swap(Predicate pred) {
+            static const Predicate swapped[] = {Predicate::NONE, Predicate::EQ, Predicate::NE, Predicate::SLT,
+                                                Predicate::SLE, Predicate::SGT, Predicate::SGE};
+            return swapped[(int) pred];
+        }
+
+        // Narrows the range of a value known to satisfy `value pred other`
+        static Range narrow(Range range, Predicate pred, const Range &other) {
+            if (other.isEmpty()) {
+                return range;
+            }
+            switch (pred) {
+                case Predicate::EQ:
+                    return range.meet(other);
+                case Predicate::NE:
+                    if (other.lo == other.hi) {
+                        if (range.lo == other.lo) {
+                            range.lo++;
+                        }
+                        if (range.hi == other.lo) {
+                            range.hi--;
+                        }
+                    }
+                    return range;
+                case Predicate::SGT:
+                    return range.meet({other.lo + 1, INT32_MAX});
+                case Predicate::SGE:
+                    return range.meet({other.lo, INT32_MAX});
+                case Predicate::SLT:
+                    return range.meet({INT32_MIN, other.hi - 1});
+                default:
+                    return range.meet({INT32_MIN, other.hi});
+            }
+        }
+
+        // The range of a value where it is used in the block
+        Range rangeAt(const Value &value, const Block *block) const {
+            Range range = constant(value);
+            if (value.isConst() || range.isEmpty()) {
+                return range;
+            }
+            for (Block *guarded = nearestGuard[block->id]; guarded; guarded = outerGuard(guarded)) {
+                Predicate pred;
+                Value other;
+                if (guardOn(guarded, value, pred, other)) {
+                    range = narrow(range, pred, constant(other));
+                }
+            }
+            return range;
+        }
+
+        // The next guarded block that dominates this guarded one
+        Block *outerGuard(const Block *guarded) const {
+            Block *dominator = cfg.idom[guarded->id];
+            return dominator ? nearestGuard[dominator->id] : nullptr;
+        }
+
+        // Whether the guard of the block compares the value, as `value pred other`
+        bool guardOn(const Block *guarded, const Value &value, Predicate &pred, Value &other) const {
+            const Instruction *cmp = guard[guarded->id];
+            pred = guardTaken[guarded->id] ? cmp->pred : negate(cmp->pred);
+            if (cmp->ops[0].isReg() && cmp->ops[0].n == value.n) {
+                other = cmp->ops[1];
+                return true;
+            }
+            if (cmp->ops[1].isReg() && cmp->ops[1].n == value.n) {
+                pred = swap(pred);
+                other = cmp->ops[0];
+                return true;
+            }
+            return false;
+        }
+
+        Range evaluate(const Instruction *instruction) const {
+            const Block *block = instruction->block;
+            if (instruction->op == Opcode::PHI) {
+                Range range = Range::empty();
+                for (unsigned i = 0; i < instruction->numOps; i++) {
+                    range = range.join(rangeAt(instruction->ops[i], instruction->targets[i]));
+                }
+                return range;
+            }
+            Type type = instruction->type;
+            if (instruction->op == Opcode::ICMP || (instruction->op == Opcode::XOR && type == Type::I1)) {
+                return {0, 1};
+            }
+            if (instruction->op == Opcode::ZEXT) {
+                return rangeAt(instruction->ops[0], block);
+            }
+            if (instruction->op == Opcode::TRUNC) {
+                Range a = rangeAt(instruction->ops[0], block);
+                return a.isEmpty() ? a : Range::wrap(a.lo, a.hi, type);
+            }
+            if (instruction->op > Opcode::XOR) {
+                return Range::full(type);
+            }
+            Range a = rangeAt(instruction->ops[0], block);
+            Range b = rangeAt(instruction->ops[1], block);
+            if (a.isEmpty() || b.isEmpty()) {
+                return Range::empty();
+            }
+            switch (instruction->op) {
+                case Opcode::ADD:
+                    return Range::wrap(a.lo + b.lo, a.hi + b.hi, type);
+                case Opcode::SUB:
+                    return Range::wrap(a.lo - b.hi, a.hi - b.lo, type);
+                case Opcode::MUL: {
+                    int64_t corners[] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+                    auto bounds = std::minmax_element(corners, corners + 4);
+                    return Range::wrap(*bounds.first, *bounds.second, type);
+                }
+                case Opcode::SDIV:
+                    if (a.lo >= 0 && b.lo > 0) {
+                        return {a.lo / b.hi, a.hi / b.lo};
+                    }
+                    // |a / b| <= |a|, except for INT_MIN / -1, which wraps around to INT_MIN itself
+                    return Range::wrap(-std::max(-a.lo, a.hi), std::max(-a.lo, a.hi));
+                case Opcode::UDIV:
+                    if (a.lo >= 0 && b.lo >= 0) {
+                        return {0, a.hi};
+                    }
+                    return Range::full();
+                case Opcode::AND:
+                    if (a.lo >= 0 && b.lo >= 0) {
+                        return {0, std::min(a.hi, b.hi)};
+                    }
+                    if (a.lo >= 0 || b.lo >= 0) {
+                        return {0, a.lo >= 0 ? a.hi : b.hi};
+                    }
+                    return Range::full();
+                default:
+                    return Range::full(type);
+            }
+        }
+
+        void findGuards() {
+            for (Block *block: cfg.order) {
+                const std::vector<Block *> &preds = cfg.preds[block->id];
+                const Instruction *branch = preds.size() == 1 ? preds[0]->last : nullptr;
+                if (branch && branch->op == Opcode::CONDBR && branch->targets[0] != branch->targets[1] &&
+                    branch->ops[0].isReg()) {
+                    Instruction *cmp = definition[branch->ops[0].n];
+                    if (cmp && cmp->op == Opcode::ICMP) {
+                        guard[block->id] = cmp;
+                        guardTaken[block->id] = branch->targets[0] == block;
+                    }
+                }
+                Block *dominator = cfg.idom[block->id];
+                nearestGuard[block->id] = guard[block->id] ? block : dominator ? nearestGuard[dominator->id] : nullptr;
+            }
+        }
+
+    public:
+        explicit RangeAnalysis(Function &function) : function(function), cfg(function) {}
+
+        void run() {
+            size_t numRegs = function.regTypes.size();
+            ranges.assign(numRegs, Range::empty());
+            growth.assign(numRegs, 0);
+            definition.assign(numRegs, nullptr);
+            for (size_t i = 0; i < function.paramTypes.size(); i++) {
+                ranges[i] = Range::full();
+            }
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    if (instruction->result >= 0) {
+                        definition[instruction->result] = instruction;
+                    }
+                }
+            }
+            guard.assign(function.numBlocks, nullptr);
+            guardTaken.assign(function.numBlocks, false);
+            nearestGuard.assign(function.numBlocks, nullptr);
+            findGuards();
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (Block *block: cfg.order) {
+                    for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                        if (instruction->result < 0) {
+                            continue;
+                        }
+                        Range old = ranges[instruction->result];
+                        Range range = old.join(evaluate(instruction));
+                        if (range == old) {
+                            continue;
+                        }
+                        if (instruction->op == Opcode::PHI && ++growth[instruction->result] > SAF_HARKHAVA) {
+                            Range full = Range::full(instruction->type);
+                            if (range.lo < old.lo) {
+                                range.lo = full.lo;
+                            }
+                            if (range.hi > old.hi) {
+                                range.hi = full.hi;
+                            }
+                        }
+                        ranges[instruction->result] = range;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // The values the value can take where it is used in the block
+        Range at(const Value &value, const Block *block) const {
+            return rangeAt(value, block);
+        }
+
+        // Whether the value, used in the block, can be zero there
+        bool mayBeZero(const Value &value, const Block *block) const {
+            Range range = rangeAt(value, block);
+            if (!range.isEmpty() && !range.contains(0)) {
+                return false;
+            }
+            // An interval cannot leave out 0 from the middle, which is what `if (count != 0)` does
+            for (Block *guarded = nearestGuard[block->id]; value.isReg() && guarded; guarded = outerGuard(guarded)) {
+                Predicate pred;
+                Value other;
+                if (guardOn(guarded, value, pred, other) && pred == Predicate::NE && other.isConst() &&
+                    other.n == 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    static bool isDivisionCheck(const Instruction *instruction) {
+        return instruction->op == Opcode::CALL && std::string(instruction->callee) == "check_division";
+    }
+
+    void removeDivisionChecks(Function &function) {
+        RangeAnalysis analysis(function);
+        analysis.run();
+        for (Block *block = function.first; block; block = block->next) {
+            Instruction *next;
+            for (Instruction *instruction = block->first; instruction; instruction = next) {
+                next = instruction->next;
+                if (isDivisionCheck(instruction) && !analysis.mayBeZero(instruction->ops[0], block)) {
+                    block->remove(instruction);
+                }
+            }
+        }
+    }
+
+    // Whether the value fits in the low bits a mask of the form 2^k - 1 keeps
+    static bool fitsMask(const Range &range, const Value &mask) {
+        uint32_t bits = mask.n;
+        return mask.isConst() && mask.type == Type::I32 && (bits & (bits + 1)) == 0 && !range.isEmpty() &&
+               range.lo >= 0 && range.hi <= bits;
+    }
+
+    void removeMasks(Function &function) {
+        RangeAnalysis analysis(function);
+        analysis.run();
+        std::vector<Instruction *> definition(function.regTypes.size(), nullptr);
+        std::vector<Value> replacement(function.regTypes.size());
+        for (Block *block = function.first; block; block = block->next) {
+            Instruction *next;
+            for (Instruction *instruction = block->first; instruction; instruction = next) {
+                next = instruction->next;
+                if (instruction->result >= 0) {
+                    definition[instruction->result] = instruction;
+                }
+                const Value *ops = instruction->ops;
+                Value kept;
+                if (instruction->op == Opcode::AND) {
+                    for (int i = 0; i < 2 && kept.kind == Value::Kind::NONE; i++) {
+                        if (fitsMask(analysis.at(ops[i], block), ops[1 - i])) {
+                            kept = ops[i];
+                        }
+                    }
+                } else if (instruction->op == Opcode::ZEXT && ops[0].isReg() && definition[ops[0].n] &&
+                           definition[ops[0].n]->op == Opcode::TRUNC) {
+                    // A value that was cut to a byte and widened again is unchanged if it was a byte already
+                    const Value &original = definition[ops[0].n]->ops[0];
+                    if (fitsMask(analysis.at(original, block), Value::constant(UINT8_MAX))) {
+                        kept = original;
+                    }
+                } else if (instruction->op == Opcode::TRUNC && ops[0].isReg() && definition[ops[0].n] &&
+                           definition[ops[0].n]->op == Opcode::ZEXT &&
+                           definition[ops[0].n]->ops[0].type == Type::I8) {
+                    // A byte widened and cut back, as an inlined call passes and returns bytes
+                    kept = definition[ops[0].n]->ops[0];
+                }
+                if (kept.kind != Value::Kind::NONE) {
+                    replacement[instruction->result] = kept;
+                    block->remove(instruction);
+                }
+            }
+        }
+
+        // The operands are replaced, and the truncations and extensions left without a use go as well
+        std::vector<unsigned> uses(function.regTypes.size(), 0);
+        for (Block *block = function.first; block; block = block->next) {
+            for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                for (unsigned i = 0; i < instruction->numOps; i++) {
+                    Value &op = instruction->ops[i];
+                    while (op.isReg() && replacement[op.n].kind != Value::Kind::NONE) {
+                        op = replacement[op.n];
+                    }
+                    if (op.isReg()) {
+                        uses[op.n]++;
+                    }
+                }
+            }
+        }
+        for (Block *block = function.first; block; block = block->next) {
+            Instruction *next;
+            for (Instruction *instruction = block->first; instruction; instruction = next) {
+                next = instruction->next;
+                if ((instruction->op == Opcode::TRUNC || instruction->op == Opcode::ZEXT) &&
+                    uses[instruction->result] == 0) {
+                    block->remove(instruction);
+                }
+            }
+        }
+    }
+
+    void lowerDivisionChecks(Function &function) {
+        Block *error = nullptr;
+        // A split block is placed right after the block it came from, so the loop goes on into it
+        for (Block *block = function.first; block; block = block->next) {
+            Instruction *check = block->first;
+            while (check && !isDivisionCheck(check)) {
+                check = check->next;
+            }
+            if (!check) {
+                continue;
+            }
+            if (!error) {
+                // One error block per function, placed last, away from the code that runs
+                error = function.newBlock();
+                Value message = function.newReg(Type::I8_PTR);
+                error->append(function.create(Opcode::STRING, Type::I8_PTR, message.n,
+                                              {Value::constant(DIV_BY_ZERO_ERROR)}));
+                Instruction *print = function.create(Opcode::CALL, Type::VOID, -1, {message});
+                print->callee = "print";
+                error->append(print);
+                Instruction *exit = function.create(Opcode::CALL, Type::VOID, -1, {Value::constant(0)});
+                exit->callee = "exit";
+                error->append(exit);
+                error->append(function.create(Opcode::UNREACHABLE, Type::VOID, -1, {}));
+                function.placeAfter(function.last, error);
+            }
+
+            // The rest of the block moves to a block of its own, which the successors' phis now come from
+            Block *rest = function.newBlock();
+            function.placeAfter(block, rest);
+            while (check->next) {
+                Instruction *moved = check->next;
+                block->remove(moved);
+                rest->append(moved);
+            }
+            for (Block *succ: successors(rest)) {
+                for (Instruction *phi = succ->first; phi && phi->op == Opcode::PHI; phi = phi->next) {
+                    std::replace(phi->targets, phi->targets + phi->numTargets, block, rest);
+                }
+            }
+
+            Value isZero = function.newReg(Type::I1);
+            Value divisor = check->ops[0];
+            Instruction *cmp = function.create(Opcode::ICMP, Type::I1, isZero.n,
+                                               {divisor, Value::constant(0, divisor.type)});
+            cmp->pred = Predicate::EQ;
+            block->remove(check);
+            block->append(cmp);
+            block->append(function.create(Opcode::CONDBR, Type::VOID, -1, {isZero}, {error, rest}));
+        }
+    }
+}
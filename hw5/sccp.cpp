@@ -0,0 +1,366 @@
+#include "passes.hpp"
+#include <climits>
+
+namespace ir {
+
+    bool fold(Opcode op, Type type, Predicate pred, const Value *ops, Value &result) {
+        // Only the opcodes up to TRUNC compute a value from their operands alone
+        if (op > Opcode::TRUNC) {
+            return false;
+        }
+        // Arithmetic is done unsigned, which wraps around like the i32 instructions do
+        uint32_t a = ops[0].n;
+        uint32_t b = op == Opcode::ZEXT || op == Opcode::TRUNC ? 0 : ops[1].n;
+        int32_t value;
+        switch (op) {
+            case Opcode::ADD:
+                value = a + b;
+                break;
+            case Opcode::SUB:
+                value = a - b;
+                break;
+            case Opcode::MUL:
+                value = a * b;
+                break;
+            case Opcode::SDIV:
+                if (b == 0 || (ops[0].n == INT32_MIN && ops[1].n == -1)) {
+                    return false;
+                }
+                value = ops[0].n / ops[1].n;
+                break;
+            case Opcode::UDIV:
+                if (b == 0) {
+                    return false;
+                }
+                value = a / b;
+                break;
+            case Opcode::AND:
+                value = a & b;
+                break;
+            case Opcode::XOR:
+                value = a ^ b;
+                break;
+            case Opcode::SHL:
+            case Opcode::LSHR:
+            case Opcode::ASHR:
+                if (b >= (type == Type::I8 ? 8u : 32u)) {
+                    return false;
+                }
+                if (op == Opcode::SHL) {
+                    value = a << b;
+                } else if (op == Opcode::LSHR) {
+                    value = a >> b;
+                } else {
+                    value = type == Type::I8 ? (int8_t) a >> b : (int32_t) a >> b;
+                }
+                break;
+            case Opcode::ZEXT:
+            case Opcode::TRUNC:
+                value = a;
+                break;
+            case Opcode::ICMP:
+                switch (pred) {
+                    case Predicate::EQ:
+                        value = ops[0].n == ops[1].n;
+                        break;
+                    case Predicate::NE:
+                        value = ops[0].n != ops[1].n;
+                        break;
+                    case Predicate::SGT:
+                        value = ops[0].n > ops[1].n;
+                        break;
+                    case Predicate::SGE:
+                        value = ops[0].n >= ops[1].n;
+                        break;
+                    case Predicate::SLT:
+                        value = ops[0].n < ops[1].n;
+                        break;
+                    default:
+                        value = ops[0].n <= ops[1].n;
+                        break;
+                }
+                break;
+            default:
+                return false;
+        }
+        if (type == Type::I8) {
+            // i8 constants are kept in 0..255, so the byte arithmetic wraps around here
+            value &= 0xff;
+        }
+        result = Value::constant(value, type);
+        return true;
+    }
+
+    /* The lattice value of every register starts undefined (no executable definition seen yet), becomes a constant
+     * and finally overdefined, and never moves back up. Blocks are only visited once an edge into them is executable.
+     */
+    class ConstantPropagation {
+    private:
+        enum class Level : unsigned char {
+            UNDEFINED,
+            CONSTANT,
+            OVERDEFINED
+        };
+
+        struct Cell {
+            Level level = Level::UNDEFINED;
+            int32_t value = 0;
+        };
+
+        Function &function;
+        std::vector<Cell> cells;
+        std::vector<std::vector<Instruction *>> users;
+        std::vector<bool> executable;
+        // Bit i is set once the edge to the i-th target of the block's terminator is executable
+        std::vector<unsigned char> edges;
+        std::vector<std::pair<Block *, unsigned>> flowWork;
+        std::vector<Instruction *> ssaWork;
+        // Value that replaces a removed phi, indexed by its register
+        std::vector<Value> replacement;
+
+        Cell cell(const Value &value) const {
+            if (value.isConst()) {
+                return {Level::CONSTANT, value.n};
+            }
+            return cells[value.n];
+        }
+
+        void update(int reg, Cell value) {
+            Cell &old = cells[reg];
+            if (old.level == value.level && old.value == value.value) {
+                return;
+            }
+            old = value;
+            ssaWork.insert(ssaWork.end(), users[reg].begin(), users[reg].end());
+        }
+
+        // Number of executable edges from pred to block
+        unsigned edgesInto(const Block *pred, const Block *block) const {
+            unsigned count = 0;
+            const Instruction *terminator = pred->last;
+            for (unsigned i = 0; terminator && i < terminator->numTargets; i++) {
+                if (terminator->targets[i] == block && (edges[pred->id] >> i & 1)) {
+                    count++;
+                }
+            }
+            return count;
+        }
+
+        void visitPhi(Instruction *phi) {
+            Cell meet;
+            for (unsigned i = 0; i < phi->numOps; i++) {
+                if (!edgesInto(phi->targets[i], phi->block)) {
+                    continue;
+                }
+                Cell incoming = cell(phi->ops[i]);
+                if (incoming.level == Level::UNDEFINED) {
+                    continue;
+                }
+                if (meet.level == Level::UNDEFINED) {
+                    meet = incoming;
+                } else if (incoming.level == Level::OVERDEFINED || incoming.value != meet.value) {
+                    meet.level = Level::OVERDEFINED;
+                    break;
+                }
+            }
+            update(phi->result, meet);
+        }
+
+        void visit(Instruction *instruction) {
+            switch (instruction->op) {
+                case Opcode::PHI:
+                    visitPhi(instruction);
+                    return;
+                case Opcode::BR:
+                    flowWork.emplace_back(instruction->block, 0);
+                    return;
+                case Opcode::CONDBR: {
+                    Cell cond = cell(instruction->ops[0]);
+                    if (cond.level == Level::CONSTANT) {
+                        flowWork.emplace_back(instruction->block, cond.value ? 0 : 1);
+                    } else if (cond.level == Level::OVERDEFINED) {
+                        flowWork.emplace_back(instruction->block, 0);
+                        flowWork.emplace_back(instruction->block, 1);
+                    }
+                    return;
+                }
+                default:
+                    break;
+            }
+            if (instruction->result < 0) {
+                return;
+            }
+            if (instruction->op == Opcode::CALL || instruction->numOps == 0) {
+                update(instruction->result, {Level::OVERDEFINED, 0});
+                return;
+            }
+            // The remaining instructions with a result have at most two operands
+            Value ops[2];
+            for (unsigned i = 0; i < instruction->numOps; i++) {
+                Cell op = cell(instruction->ops[i]);
+                if (op.level == Level::OVERDEFINED) {
+                    update(instruction->result, op);
+                    return;
+                }
+                if (op.level == Level::UNDEFINED) {
+                    return;
+                }
+                ops[i] = Value::constant(op.value, instruction->ops[i].type);
+            }
+            Value result;
+            if (fold(instruction->op, instruction->type, instruction->pred, ops, result)) {
+                update(instruction->result, {Level::CONSTANT, result.n});
+            } else {
+                update(instruction->result, {Level::OVERDEFINED, 0});
+            }
+        }
+
+        void solve() {
+            executable[function.first->id] = true;
+            for (Instruction *instruction = function.first->first; instruction; instruction = instruction->next) {
+                visit(instruction);
+            }
+            while (!flowWork.empty() || !ssaWork.empty()) {
+                while (!flowWork.empty()) {
+                    Block *pred = flowWork.back().first;
+                    unsigned index = flowWork.back().second;
+                    flowWork.pop_back();
+                    if (edges[pred->id] >> index & 1) {
+                        continue;
+                    }
+                    edges[pred->id] |= 1 << index;
+                    Block *block = pred->last->targets[index];
+                    bool first = !executable[block->id];
+                    executable[block->id] = true;
+                    for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                        // A block seen before only has new work in its phis, for the new edge
+                        if (first || instruction->op == Opcode::PHI) {
+                            visit(instruction);
+                        }
+                    }
+                }
+                while (!ssaWork.empty()) {
+                    Instruction *instruction = ssaWork.back();
+                    ssaWork.pop_back();
+                    if (executable[instruction->block->id]) {
+                        visit(instruction);
+                    }
+                }
+            }
+        }
+
+        Value resolve(Value value) const {
+            while (value.isReg() && replacement[value.n].kind != Value::Kind::NONE) {
+                value = replacement[value.n];
+            }
+            return value;
+        }
+
+        // Keeps the incoming values of the phi that come over executable edges, one per edge
+        void prunePhi(Instruction *phi) {
+            unsigned kept = 0;
+            for (unsigned i = 0; i < phi->numOps; i++) {
+                Block *pred = phi->targets[i];
+                unsigned already = 0;
+                for (unsigned j = 0; j < kept; j++) {
+                    already += phi->targets[j] == pred;
+                }
+                if (executable[pred->id] && already < edgesInto(pred, phi->block)) {
+                    phi->ops[kept] = phi->ops[i];
+                    phi->targets[kept] = pred;
+                    kept++;
+                }
+            }
+            phi->numOps = phi->numTargets = kept;
+        }
+
+        void rewrite() {
+            Block *nextBlock;
+            for (Block *block = function.first; block; block = nextBlock) {
+                nextBlock = block->next;
+                if (!executable[block->id]) {
+                    function.remove(block);
+                    continue;
+                }
+                Instruction *next;
+                for (Instruction *instruction = block->first; instruction; instruction = next) {
+                    next = instruction->next;
+                    if (instruction->result >= 0 && cells[instruction->result].level == Level::CONSTANT &&
+                        instruction->op != Opcode::CALL) {
+                        block->remove(instruction);
+                        continue;
+                    }
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        Value &op = instruction->ops[i];
+                        if (op.isReg() && cells[op.n].level == Level::CONSTANT) {
+                            op = Value::constant(cells[op.n].value, op.type);
+                        }
+                    }
+                    if (instruction->op == Opcode::CONDBR && instruction->ops[0].isConst()) {
+                        instruction->targets[0] = instruction->targets[instruction->ops[0].n ? 0 : 1];
+                        edges[block->id] = 1;
+                        instruction->op = Opcode::BR;
+                        instruction->numOps = 0;
+                        instruction->numTargets = 1;
+                    }
+                }
+            }
+
+            // Now that the edges are final, phis lose the incoming values of removed edges and a phi left with a
+            // single value is replaced by it
+            for (Block *block = function.first; block; block = block->next) {
+                Instruction *next;
+                for (Instruction *phi = block->first; phi && phi->op == Opcode::PHI; phi = next) {
+                    next = phi->next;
+                    prunePhi(phi);
+                    Value only = resolve(phi->ops[0]);
+                    bool same = phi->numOps > 0;
+                    for (unsigned i = 1; same && i < phi->numOps; i++) {
+                        Value op = resolve(phi->ops[i]);
+                        same = op.kind == only.kind && op.n == only.n;
+                    }
+                    if (same) {
+                        replacement[phi->result] = only;
+                        block->remove(phi);
+                    }
+                }
+            }
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        instruction->ops[i] = resolve(instruction->ops[i]);
+                    }
+                }
+            }
+        }
+
+    public:
+        explicit ConstantPropagation(Function &function) : function(function) {}
+
+        void run() {
+            cells.resize(function.regTypes.size());
+            for (size_t i = 0; i < function.paramTypes.size(); i++) {
+                cells[i].level = Level::OVERDEFINED;
+            }
+            users.resize(function.regTypes.size());
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        if (instruction->ops[i].isReg()) {
+                            users[instruction->ops[i].n].push_back(instruction);
+                        }
+                    }
+                }
+            }
+            executable.assign(function.numBlocks, false);
+            edges.assign(function.numBlocks, 0);
+            replacement.assign(function.regTypes.size(), Value());
+            solve();
+            rewrite();
+        }
+    };
+
+    void propagateConstants(Function &function) {
+        ConstantPropagation(function).run();
+    }
+}
@@ -0,0 +1,246 @@
+#include "passes.hpp"
+#include "cfg.hpp"
+#include <algorithm>
+
+/* CFG simplification
+ * The front ends lower every statement where it appears, so the code after a return, break or continue ends up in
+ * blocks nothing jumps to, and an if or a loop leaves blocks that only jump on. The rules below are applied until
+ * none of them changes anything:
+ * - blocks that cannot be reached from the entry are removed
+ * - a conditional branch on a constant, or with the same target twice, becomes a jump
+ * - a block that only jumps on is bypassed: its predecessors jump straight to its target (jump threading)
+ * - a block whose only predecessor jumps to it is appended to that predecessor
+ */
+namespace ir {
+
+    class CfgSimplifier {
+    private:
+        Function &function;
+        // Predecessors of every block, once per edge
+        std::vector<std::vector<Block *>> preds;
+        // Value that replaces a removed phi, indexed by its register
+        std::vector<Value> replacement;
+
+        Value resolve(Value value) const {
+            while (value.isReg() && replacement[value.n].kind != Value::Kind::NONE) {
+                value = replacement[value.n];
+            }
+            return value;
+        }
+
+        // Removes one edge from pred to block, and the incoming value of every phi of the block along it
+        void removeEdge(Block *pred, Block *block) {
+            std::vector<Block *> &blockPreds = preds[block->id];
+            blockPreds.erase(std::find(blockPreds.begin(), blockPreds.end(), pred));
+            for (Instruction *phi = block->first; phi && phi->op == Opcode::PHI; phi = phi->next) {
+                unsigned i = std::find(phi->targets, phi->targets + phi->numTargets, pred) - phi->targets;
+                if (i < phi->numOps) {
+                    std::copy(phi->ops + i + 1, phi->ops + phi->numOps, phi->ops + i);
+                    std::copy(phi->targets + i + 1, phi->targets + phi->numTargets, phi->targets + i);
+                    phi->numOps--;
+                    phi->numTargets--;
+                }
+            }
+        }
+
+        void removeBlock(Block *block) {
+            for (Block *succ: successors(block)) {
+                // A successor in a dead loop may be gone already, with its edges
+                if (!preds[succ->id].empty()) {
+                    removeEdge(block, succ);
+                }
+            }
+            preds[block->id].clear();
+            function.remove(block);
+        }
+
+        bool removeUnreachable() {
+            Cfg cfg(function);
+            bool changed = false;
+            Block *next;
+            for (Block *block = function.first; block; block = next) {
+                next = block->next;
+                if (!cfg.reachable(block)) {
+                    removeBlock(block);
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        bool foldBranch(Block *block) {
+            Instruction *branch = block->last;
+            if (branch->op != Opcode::CONDBR) {
+                return false;
+            }
+            Value cond = resolve(branch->ops[0]);
+            if (!cond.isConst() && branch->targets[0] != branch->targets[1]) {
+                return false;
+            }
+            unsigned taken = cond.isConst() && !cond.n ? 1 : 0;
+            removeEdge(block, branch->targets[1 - taken]);
+            branch->targets[0] = branch->targets[taken];
+            branch->op = Opcode::BR;
+            branch->numOps = 0;
+            branch->numTargets = 1;
+            return true;
+        }
+
+        // Bypasses a block that holds nothing but a jump
+        bool thread(Block *block) {
+            Instruction *jump = block->last;
+            Block *target = jump->targets[0];
+            if (block == function.first || block->first != jump || jump->op != Opcode::BR || target == block) {
+                return false;
+            }
+            std::vector<Block *> blockPreds = preds[block->id];
+            bool hasPhis = target->first->op == Opcode::PHI;
+            for (Block *pred: blockPreds) {
+                // A phi cannot take two different values from the same predecessor
+                if (hasPhis && std::find(preds[target->id].begin(), preds[target->id].end(), pred) !=
+                               preds[target->id].end()) {
+                    return false;
+                }
+            }
+
+            // Every phi of the target takes the value it had from the block from each of the block's predecessors
+            for (Instruction *phi = target->first; phi && phi->op == Opcode::PHI; phi = phi->next) {
+                unsigned size = phi->numOps - 1 + blockPreds.size();
+                Value *ops = function.arena.array<Value>(size);
+                Block **targets = function.arena.array<Block *>(size);
+                unsigned n = 0;
+                Value incoming;
+                for (unsigned i = 0; i < phi->numOps; i++) {
+                    if (phi->targets[i] == block) {
+                        incoming = phi->ops[i];
+                    } else {
+                        ops[n] = phi->ops[i];
+                        targets[n++] = phi->targets[i];
+                    }
+                }
+                for (Block *pred: blockPreds) {
+                    ops[n] = incoming;
+                    targets[n++] = pred;
+                }
+                phi->ops = ops;
+                phi->targets = targets;
+                phi->numOps = phi->numTargets = size;
+            }
+            for (Block *pred: blockPreds) {
+                Instruction *branch = pred->last;
+                std::replace(branch->targets, branch->targets + branch->numTargets, block, target);
+            }
+            std::vector<Block *> &targetPreds = preds[target->id];
+            targetPreds.erase(std::find(targetPreds.begin(), targetPreds.end(), block));
+            targetPreds.insert(targetPreds.end(), blockPreds.begin(), blockPreds.end());
+            preds[block->id].clear();
+            function.remove(block);
+            return true;
+        }
+
+        // Appends the only successor of a block to it, when the block is its only predecessor
+        bool merge(Block *block) {
+            Instruction *jump = block->last;
+            if (jump->op != Opcode::BR) {
+                return false;
+            }
+            Block *succ = jump->targets[0];
+            if (succ == block || succ == function.first || preds[succ->id].size() != 1) {
+                return false;
+            }
+            block->remove(jump);
+            Instruction *next;
+            for (Instruction *instruction = succ->first; instruction; instruction = next) {
+                next = instruction->next;
+                succ->remove(instruction);
+                if (instruction->op == Opcode::PHI) {
+                    replacement[instruction->result] = instruction->ops[0];
+                } else {
+                    block->append(instruction);
+                }
+            }
+            for (Block *after: successors(block)) {
+                for (Instruction *phi = after->first; phi && phi->op == Opcode::PHI; phi = phi->next) {
+                    std::replace(phi->targets, phi->targets + phi->numTargets, succ, block);
+                }
+                std::replace(preds[after->id].begin(), preds[after->id].end(), succ, block);
+            }
+            preds[succ->id].clear();
+            function.remove(succ);
+            return true;
+        }
+
+        // Replaces the phis whose incoming values are all the same value (or the phi itself) by that value
+        void removeTrivialPhis() {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (Block *block = function.first; block; block = block->next) {
+                    Instruction *next;
+                    for (Instruction *phi = block->first; phi && phi->op == Opcode::PHI; phi = next) {
+                        next = phi->next;
+                        Value only;
+                        bool trivial = true;
+                        for (unsigned i = 0; trivial && i < phi->numOps; i++) {
+                            Value op = resolve(phi->ops[i]);
+                            if (op.isReg() && op.n == phi->result) {
+                                continue;
+                            }
+                            trivial = only.kind == Value::Kind::NONE || (op.kind == only.kind && op.n == only.n);
+                            only = op;
+                        }
+                        if (trivial && only.kind != Value::Kind::NONE) {
+                            replacement[phi->result] = only;
+                            block->remove(phi);
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+
+    public:
+        explicit CfgSimplifier(Function &function) : function(function) {}
+
+        void run() {
+            preds.resize(function.numBlocks);
+            for (Block *block = function.first; block; block = block->next) {
+                for (Block *succ: successors(block)) {
+                    preds[succ->id].push_back(block);
+                }
+            }
+            replacement.assign(function.regTypes.size(), Value());
+
+            bool changed = true;
+            while (changed) {
+                changed = removeUnreachable();
+                Block *next;
+                for (Block *block = function.first; block; block = next) {
+                    next = block->next;
+                    if (foldBranch(block)) {
+                        changed = true;
+                    }
+                    if (thread(block)) {
+                        changed = true;
+                    } else if (merge(block)) {
+                        // The merged block ends with the successor's terminator now, which may allow more
+                        next = block;
+                        changed = true;
+                    }
+                }
+            }
+            removeTrivialPhis();
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        instruction->ops[i] = resolve(instruction->ops[i]);
+                    }
+                }
+            }
+        }
+    };
+
+    void simplifyCfg(Function &function) {
+        CfgSimplifier(function).run();
+    }
+}
@@ -0,0 +1,236 @@
+#include "passes.hpp"
+#include "cfg.hpp"
+#include <algorithm>
+
+/* SSA construction after Braun et al., "Simple and Efficient Construction of Static Single Assignment Form".
+ * The blocks are filled in layout order. A store defines the current value of its slot in the block, and a load reads
+ * it, looking through the predecessors when the block has not defined it: a block with one predecessor takes its
+ * value, a block with several gets a phi. A block is sealed once all of its predecessors are filled; until then the
+ * phis it needs are left incomplete, which is what happens at the header of a loop before its back edges are seen.
+ * Phis whose operands are all the same value (or the phi itself) are removed again.
+ */
+namespace ir {
+
+    class SsaBuilder {
+    private:
+        Function &function;
+        std::vector<std::vector<Block *>> preds;
+        // Predecessors of every block that are not filled yet, the block is sealed when it reaches zero
+        std::vector<unsigned> unfilledPreds;
+        std::vector<bool> sealed;
+        std::vector<std::vector<std::pair<int, Instruction *>>> incompletePhis;
+        // Current value of every slot at the end of every block, indexed by block and then slot
+        std::vector<std::vector<Value>> currentDef;
+        int numSlots = 0;
+        // The type of the values every slot holds, i8 or i32
+        std::vector<Type> slotTypes;
+        // The slot an alloca register addresses, -1 for other registers
+        std::vector<int> slotOf;
+        // Slots whose address is used other than by a load or store, they stay in memory
+        std::vector<bool> escapes;
+        // Value that replaces a removed load or phi, indexed by its register
+        std::vector<Value> replacement;
+        std::vector<Instruction *> phis;
+
+        static bool same(const Value &a, const Value &b) {
+            return a.kind == b.kind && a.type == b.type && a.n == b.n;
+        }
+
+        Value resolve(Value value) {
+            while (value.isReg() && replacement[value.n].kind != Value::Kind::NONE) {
+                value = replacement[value.n];
+            }
+            return value;
+        }
+
+        int promotedSlot(const Value &pointer) const {
+            if (!pointer.isReg() || slotOf[pointer.n] < 0 || escapes[slotOf[pointer.n]]) {
+                return -1;
+            }
+            return slotOf[pointer.n];
+        }
+
+        // Gives every alloca a slot and finds the slots whose addresses are used other than by a load or store
+        void findSlots() {
+            slotOf.assign(function.regTypes.size(), -1);
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    Value *ops = instruction->ops;
+                    if (instruction->op == Opcode::ALLOCA) {
+                        slotOf[instruction->result] = numSlots++;
+                        slotTypes.push_back(instruction->type == Type::I8_PTR ? Type::I8 : Type::I32);
+                        escapes.push_back(false);
+                        continue;
+                    }
+                    // The address operand of a load or a store is the only use that does not escape
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        bool address = (instruction->op == Opcode::LOAD && i == 0) ||
+                                       (instruction->op == Opcode::STORE && i == 1);
+                        if (!address && ops[i].isReg() && slotOf[ops[i].n] >= 0) {
+                            escapes[slotOf[ops[i].n]] = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        Instruction *newPhi(int slot, Block *block) {
+            Type type = slotTypes[slot];
+            Instruction *phi = function.create(Opcode::PHI, type, function.newReg(type).n, {});
+            phi->numOps = phi->numTargets = preds[block->id].size();
+            phi->ops = function.arena.array<Value>(phi->numOps);
+            phi->targets = function.arena.array<Block *>(phi->numTargets);
+            replacement.emplace_back();
+            block->prepend(phi);
+            phis.push_back(phi);
+            return phi;
+        }
+
+        Value readVariable(int slot, Block *block) {
+            Value value = currentDef[block->id][slot];
+            if (value.kind != Value::Kind::NONE) {
+                return resolve(value);
+            }
+            const std::vector<Block *> &blockPreds = preds[block->id];
+            if (!sealed[block->id]) {
+                Instruction *phi = newPhi(slot, block);
+                incompletePhis[block->id].emplace_back(slot, phi);
+                value = Value::reg(phi->result, phi->type);
+            } else if (blockPreds.empty()) {
+                // Read before any store, only possible in unreachable code
+                value = Value::constant(0, slotTypes[slot]);
+            } else if (blockPreds.size() == 1) {
+                value = readVariable(slot, blockPreds[0]);
+            } else {
+                Instruction *phi = newPhi(slot, block);
+                // Defined before the operands are read, which breaks the cycles through loops
+                currentDef[block->id][slot] = Value::reg(phi->result, phi->type);
+                value = addOperands(slot, phi);
+            }
+            currentDef[block->id][slot] = value;
+            return value;
+        }
+
+        Value addOperands(int slot, Instruction *phi) {
+            const std::vector<Block *> &blockPreds = preds[phi->block->id];
+            for (unsigned i = 0; i < blockPreds.size(); i++) {
+                phi->ops[i] = readVariable(slot, blockPreds[i]);
+                phi->targets[i] = blockPreds[i];
+            }
+            return tryRemoveTrivialPhi(phi);
+        }
+
+        // Replaces the phi by its only operand other than itself, if it has one
+        Value tryRemoveTrivialPhi(Instruction *phi) {
+            Value self = Value::reg(phi->result, phi->type);
+            Value only;
+            for (unsigned i = 0; i < phi->numOps; i++) {
+                Value op = resolve(phi->ops[i]);
+                if (same(op, only) || same(op, self)) {
+                    continue;
+                }
+                if (only.kind != Value::Kind::NONE) {
+                    return self;
+                }
+                only = op;
+            }
+            if (only.kind == Value::Kind::NONE) {
+                only = Value::constant(0, phi->type);
+            }
+            replacement[phi->result] = only;
+            phi->block->remove(phi);
+            return only;
+        }
+
+        void seal(Block *block) {
+            sealed[block->id] = true;
+            std::vector<std::pair<int, Instruction *>> pending;
+            pending.swap(incompletePhis[block->id]);
+            for (auto &entry: pending) {
+                addOperands(entry.first, entry.second);
+            }
+        }
+
+        // Phis the builder adds to the block are prepended, so they are never visited here
+        void fill(Block *block) {
+            Instruction *next;
+            for (Instruction *instruction = block->first; instruction; instruction = next) {
+                next = instruction->next;
+                Value *ops = instruction->ops;
+                for (unsigned i = 0; i < instruction->numOps; i++) {
+                    ops[i] = resolve(ops[i]);
+                }
+                int slot;
+                if (instruction->op == Opcode::ALLOCA && !escapes[slotOf[instruction->result]]) {
+                    block->remove(instruction);
+                } else if (instruction->op == Opcode::LOAD && (slot = promotedSlot(ops[0])) >= 0) {
+                    replacement[instruction->result] = readVariable(slot, block);
+                    block->remove(instruction);
+                } else if (instruction->op == Opcode::STORE && (slot = promotedSlot(ops[1])) >= 0) {
+                    currentDef[block->id][slot] = ops[0];
+                    block->remove(instruction);
+                }
+            }
+        }
+
+    public:
+        explicit SsaBuilder(Function &function) : function(function) {}
+
+        void run() {
+            findSlots();
+            if (std::find(escapes.begin(), escapes.end(), false) == escapes.end()) {
+                return;
+            }
+
+            preds.resize(function.numBlocks);
+            unfilledPreds.assign(function.numBlocks, 0);
+            for (Block *block = function.first; block; block = block->next) {
+                for (Block *succ: successors(block)) {
+                    preds[succ->id].push_back(block);
+                    unfilledPreds[succ->id]++;
+                }
+            }
+            sealed.assign(function.numBlocks, false);
+            incompletePhis.resize(function.numBlocks);
+            currentDef.assign(function.numBlocks, std::vector<Value>(numSlots));
+            replacement.assign(function.regTypes.size(), Value());
+
+            for (Block *block = function.first; block; block = block->next) {
+                if (unfilledPreds[block->id] == 0 && !sealed[block->id]) {
+                    seal(block);
+                }
+                fill(block);
+                for (Block *succ: successors(block)) {
+                    if (--unfilledPreds[succ->id] == 0 && !sealed[succ->id]) {
+                        seal(succ);
+                    }
+                }
+            }
+
+            // Removing a phi can leave another one trivial, which only shows once all of them are complete
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (Instruction *phi: phis) {
+                    if (replacement[phi->result].kind == Value::Kind::NONE) {
+                        Value self = Value::reg(phi->result, phi->type);
+                        if (!same(tryRemoveTrivialPhi(phi), self)) {
+                            changed = true;
+                        }
+                    }
+                }
+            }
+            for (Block *block = function.first; block; block = block->next) {
+                for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                    for (unsigned i = 0; i < instruction->numOps; i++) {
+                        instruction->ops[i] = resolve(instruction->ops[i]);
+                    }
+                }
+            }
+        }
+    };
+
+    void buildSsa(Function &function) {
+        SsaBuilder(function).run();
+    }
+}
@@ -0,0 +1,173 @@
+#include "passes.hpp"
+#include "cfg.hpp"
+#include <algorithm>
+
+/* Tail calls
+ * A call is in tail position when the function returns what it returns right after it. The generator passes ints,
+ * bytes and bools as i32, so a byte or bool call reaches the return cut to its type and widened again:
+ *     %c = call i32 @f(...)          %c = call i32 @f(...)
+ *     %b = trunc i32 %c to i8        %b = icmp ne i32 %c, 0
+ *     %r = zext i8 %b to i32         %r = zext i1 %b to i32
+ *     ret i32 %r                     ret i32 %r
+ * which gives back %c unchanged when every return of the function gives back a widened byte (bool). A void function
+ * may also jump to the return at its end.
+ */
+namespace ir {
+
+    static std::vector<Instruction *> definitions(const Function &function) {
+        std::vector<Instruction *> definition(function.regTypes.size(), nullptr);
+        for (Block *block = function.first; block; block = block->next) {
+            for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                if (instruction->result >= 0) {
+                    definition[instruction->result] = instruction;
+                }
+            }
+        }
+        return definition;
+    }
+
+    // Whether every return gives back a widened value of the narrow type: a zext from it, or a constant it holds
+    static bool returnsOnly(const Function &function, Type narrow, const std::vector<Instruction *> &definition) {
+        int max = narrow == Type::I1 ? 1 : UINT8_MAX;
+        for (Block *block = function.first; block; block = block->next) {
+            Instruction *ret = block->last;
+            if (ret->op != Opcode::RET || ret->numOps == 0) {
+                continue;
+            }
+            const Value &value = ret->ops[0];
+            const Instruction *widen = value.isReg() ? definition[value.n] : nullptr;
+            if (value.isConst() ? value.n < 0 || value.n > max :
+                !widen || widen->op != Opcode::ZEXT || widen->ops[0].type != narrow) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The call in tail position at the end of the block, nullptr for none
+    static Instruction *tailCall(const Function &function, Block *block, const std::vector<Instruction *> &definition) {
+        Instruction *last = block->last;
+        Instruction *call = last->prev;
+        if (last->op == Opcode::BR) {
+            Instruction *target = last->targets[0]->first;
+            return target->op == Opcode::RET && target->numOps == 0 && call && call->op == Opcode::CALL ? call : nullptr;
+        }
+        if (last->op != Opcode::RET) {
+            return nullptr;
+        }
+        if (last->numOps == 0) {
+            return call && call->op == Opcode::CALL ? call : nullptr;
+        }
+        if (!last->ops[0].isReg() || !call) {
+            return nullptr;
+        }
+        if (call->op == Opcode::CALL) {
+            return call->result == last->ops[0].n ? call : nullptr;
+        }
+
+        // A byte or a bool on its way back
+        Instruction *widen = call;
+        if (widen->op != Opcode::ZEXT || widen->result != last->ops[0].n) {
+            return nullptr;
+        }
+        Instruction *narrow = widen->prev;
+        if (!narrow || narrow->result != widen->ops[0].n ||
+            !(narrow->op == Opcode::TRUNC || (narrow->op == Opcode::ICMP && narrow->pred == Predicate::NE &&
+                                              narrow->ops[1].isConst() && narrow->ops[1].n == 0))) {
+            return nullptr;
+        }
+        call = narrow->prev;
+        if (!call || call->op != Opcode::CALL || call->result != narrow->ops[0].n) {
+            return nullptr;
+        }
+        return returnsOnly(function, narrow->type, definition) ? call : nullptr;
+    }
+
+    void eliminateTailRecursion(Function &function) {
+        std::vector<Instruction *> definition = definitions(function);
+        std::vector<Instruction *> calls;
+        for (Block *block = function.first; block; block = block->next) {
+            Instruction *call = tailCall(function, block, definition);
+            if (call && function.name == call->callee) {
+                calls.push_back(call);
+            }
+        }
+        if (calls.empty()) {
+            return;
+        }
+
+        // The body moves to a loop header after the entry, and the allocas stay in the entry
+        Block *entry = function.first;
+        Block *header = function.newBlock();
+        function.placeAfter(entry, header);
+        Instruction *next;
+        for (Instruction *instruction = entry->first; instruction; instruction = next) {
+            next = instruction->next;
+            if (instruction->op != Opcode::ALLOCA) {
+                entry->remove(instruction);
+                header->append(instruction);
+            }
+        }
+        entry->append(function.create(Opcode::BR, Type::VOID, -1, {}, {header}));
+        for (Block *succ: successors(header)) {
+            for (Instruction *phi = succ->first; phi && phi->op == Opcode::PHI; phi = phi->next) {
+                std::replace(phi->targets, phi->targets + phi->numTargets, entry, header);
+            }
+        }
+
+        // Every parameter becomes a phi of the header, of the arguments of the iteration
+        unsigned numParams = function.paramTypes.size();
+        std::vector<Value> params;
+        for (unsigned i = 0; i < numParams; i++) {
+            params.push_back(function.newReg(function.paramTypes[i]));
+        }
+        for (Block *block = function.first; block; block = block->next) {
+            for (Instruction *instruction = block->first; instruction; instruction = instruction->next) {
+                for (unsigned i = 0; i < instruction->numOps; i++) {
+                    Value &op = instruction->ops[i];
+                    if (op.isReg() && op.n < (int) numParams) {
+                        op = params[op.n];
+                    }
+                }
+            }
+        }
+        std::vector<std::vector<Value>> incoming(numParams);
+        std::vector<Block *> from = {entry};
+        for (unsigned i = 0; i < numParams; i++) {
+            incoming[i].push_back(function.param(i));
+        }
+        // The call and the return after it become a jump back to the header
+        for (Instruction *call: calls) {
+            Block *block = call->block;
+            for (unsigned i = 0; i < numParams; i++) {
+                incoming[i].push_back(call->ops[i]);
+            }
+            from.push_back(block);
+            while (block->last != call) {
+                block->remove(block->last);
+            }
+            block->remove(call);
+            block->append(function.create(Opcode::BR, Type::VOID, -1, {}, {header}));
+        }
+        for (unsigned i = numParams; i-- > 0;) {
+            header->prepend(function.create(Opcode::PHI, params[i].type, params[i].n, incoming[i], from));
+        }
+    }
+
+    void markTailCalls(Function &function) {
+        std::vector<Instruction *> definition = definitions(function);
+        for (Block *block = function.first; block; block = block->next) {
+            Instruction *call = tailCall(function, block, definition);
+            if (!call) {
+                continue;
+            }
+            // musttail needs the return right after the call, of its own value, and the prototype of the caller
+            bool exact = call->next->op == Opcode::RET && call->type == function.returnType &&
+                         call->numOps == function.paramTypes.size();
+            for (unsigned i = 0; exact && i < call->numOps; i++) {
+                exact = call->ops[i].type == function.paramTypes[i];
+            }
+            call->tailCall = exact ? TailCall::MUSTTAIL : TailCall::TAIL;
+        }
+    }
+}